@@ -1,14 +1,67 @@
 #include "catalog.h"
+#include "star_index.h"
+#include "star_color.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <jansson.h>
 
-Star *stars = NULL;
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+StarCatalog star_catalog = {0};
 int num_stars = 0;
 
+// Binary Catalog Cache
+// hip_main.dat is compiled once into a compact columnar file that later
+// startups mmap instead of parsing; the StarCatalog columns then point straight
+// into the mapping. Stars are written brightest first. The header records the
+// size and mtime of the source it was built from; any change triggers a
+// rebuild.
+#define HIP_SOURCE_FILE "hip_main.dat"
+#define HIP_CACHE_FILE "hip_main.cache"
+#define CATALOG_CACHE_MAGIC "NSKYCAT"
+#define CATALOG_CACHE_VERSION 5
+
+// Bytes per star across all columns: x, y, z, ra, dec, mag (double), bv (float), id,
+// colour index (byte)
+#define CATALOG_STAR_BYTES (6 * sizeof(double) + sizeof(float) + CATALOG_ID_LEN + 1)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t star_bytes;
+    uint32_t count;
+    uint32_t source_mtime_nsec;
+    int64_t source_size;
+    int64_t source_mtime;
+} CatalogCacheHeader;
+
+// The catalog image (header + columns) either lives in the mapped cache file or,
+// when the cache could not be written, in a heap block with the same layout.
+static void *catalog_image = NULL;
+static size_t catalog_image_size = 0;
+static int catalog_image_mapped = 0;
+
+// Magnitude Lookup
+// Stars are stored in increasing magnitude order. mag_lut[k] is the first index
+// whose magnitude exceeds MAG_LUT_MIN + k * MAG_LUT_STEP, so a magnitude cut
+// only needs a short binary search inside one bin.
+#define MAG_LUT_MIN -2.0
+#define MAG_LUT_STEP 0.1
+#define MAG_LUT_BINS 180
+static int mag_lut[MAG_LUT_BINS + 1];
+
 Constellation *constellations = NULL;
 int num_constellations = 0;
+ConstellationVertices constellation_vertices = {0};
 
 // Helper to parse Hipparcos line
 // Format: Pipe separated.
@@ -93,34 +146,267 @@ static int parse_hip_line(char *line, Star *s) {
     return 1;
 }
 
-int load_catalog() {
-    // 1. Load Stars from Hipparcos
-    FILE *f = fopen("hip_main.dat", "r");
-    if (!f) {
-        fprintf(stderr, "Error: hip_main.dat not found.\n");
-        // Fallback or fail?
-        // Let's try stars.6.json logic if hip fails?
-        // User asked to use Hipparcos.
-        return -1;
+static size_t catalog_image_bytes(int count) {
+    return sizeof(CatalogCacheHeader) + (size_t)count * CATALOG_STAR_BYTES;
+}
+
+static void build_mag_lut() {
+    int i = 0;
+    for (int k = 0; k <= MAG_LUT_BINS; k++) {
+        double edge = MAG_LUT_MIN + k * MAG_LUT_STEP;
+        while (i < num_stars && star_catalog.mag[i] <= edge) i++;
+        mag_lut[k] = i;
     }
+}
+
+// Points the star_catalog columns into an image. The header is 8-byte sized so
+// the double columns stay aligned, followed by the float, id and colour columns.
+static void attach_catalog_image(void *image, size_t size, int mapped) {
+    CatalogCacheHeader *header = image;
+    int n = header->count;
+    char *p = (char *)(header + 1);
+
+    star_catalog.x = (const double *)p; p += n * sizeof(double);
+    star_catalog.y = (const double *)p; p += n * sizeof(double);
+    star_catalog.z = (const double *)p; p += n * sizeof(double);
+    star_catalog.ra = (const double *)p; p += n * sizeof(double);
+    star_catalog.dec = (const double *)p; p += n * sizeof(double);
+    star_catalog.mag = (const double *)p; p += n * sizeof(double);
+    star_catalog.bv = (const float *)p; p += n * sizeof(float);
+    star_catalog.ids = p; p += (size_t)n * CATALOG_ID_LEN;
+    star_catalog.color = (const unsigned char *)p;
+
+    catalog_image = image;
+    catalog_image_size = size;
+    catalog_image_mapped = mapped;
+    num_stars = n;
+    build_mag_lut();
+}
+
+// Sort order for the compiled catalog: magnitude, then file order
+static const Star *sort_stars;
+
+static int compare_star_order(const void *a, const void *b) {
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+    if (sort_stars[ia].mag < sort_stars[ib].mag) return -1;
+    if (sort_stars[ia].mag > sort_stars[ib].mag) return 1;
+    return ia - ib;
+}
+
+// Parses hip_main.dat into a heap image tagged with the source's stat info.
+static void *build_catalog_image(const char *path, const struct stat *src_st, size_t *size_out) {
+    FILE *f = fopen(path, "r");
+    if (!f) return NULL;
 
     // Count lines or realloc
     // Hipparcos has ~118k lines.
-    stars = calloc(120000, sizeof(Star));
-    num_stars = 0;
+    Star *parsed = calloc(120000, sizeof(Star));
+    if (!parsed) {
+        fclose(f);
+        return NULL;
+    }
+    int count = 0;
 
     char line[1024];
     while (fgets(line, sizeof(line), f)) {
-        if (num_stars >= 120000) {
+        if (count >= 120000) {
             fprintf(stderr, "Warning: Reached maximum star limit (120000). Stopping load.\n");
             break;
         }
-        if (parse_hip_line(line, &stars[num_stars])) {
-            num_stars++;
+        if (parse_hip_line(line, &parsed[count])) {
+            count++;
         }
     }
     fclose(f);
-    printf("Loaded %d stars from Hipparcos catalog.\n", num_stars);
+
+    int *order = malloc(sizeof(int) * (count > 0 ? count : 1));
+    size_t size = catalog_image_bytes(count);
+    void *image = order ? calloc(1, size) : NULL;
+    if (image) {
+        for (int i = 0; i < count; i++) order[i] = i;
+        sort_stars = parsed;
+        qsort(order, count, sizeof(int), compare_star_order);
+
+        CatalogCacheHeader *header = image;
+        memcpy(header->magic, CATALOG_CACHE_MAGIC, sizeof(header->magic));
+        header->version = CATALOG_CACHE_VERSION;
+        header->star_bytes = CATALOG_STAR_BYTES;
+        header->count = count;
+        header->source_size = src_st->st_size;
+        header->source_mtime = src_st->st_mtim.tv_sec;
+        header->source_mtime_nsec = src_st->st_mtim.tv_nsec;
+
+        char *p = (char *)(header + 1);
+        double *x = (double *)p; p += count * sizeof(double);
+        double *y = (double *)p; p += count * sizeof(double);
+        double *z = (double *)p; p += count * sizeof(double);
+        double *ra = (double *)p; p += count * sizeof(double);
+        double *dec = (double *)p; p += count * sizeof(double);
+        double *mag = (double *)p; p += count * sizeof(double);
+        float *bv = (float *)p; p += count * sizeof(float);
+        char *ids = p; p += (size_t)count * CATALOG_ID_LEN;
+        unsigned char *color = (unsigned char *)p;
+
+        for (int i = 0; i < count; i++) {
+            const Star *src = &parsed[order[i]];
+            double ra_rad = src->ra * (M_PI / 180.0);
+            double dec_rad = src->dec * (M_PI / 180.0);
+            x[i] = cos(dec_rad) * cos(ra_rad);
+            y[i] = cos(dec_rad) * sin(ra_rad);
+            z[i] = sin(dec_rad);
+            ra[i] = src->ra;
+            dec[i] = src->dec;
+            mag[i] = src->mag;
+            bv[i] = (float)src->bv;
+            color[i] = star_color_index(src->bv);
+            if (src->id) {
+                strncpy(ids + (size_t)i * CATALOG_ID_LEN, src->id, CATALOG_ID_LEN - 1);
+            }
+        }
+        *size_out = size;
+    }
+    free(order);
+
+    for (int i = 0; i < count; i++) {
+        if (parsed[i].id) free((void*)parsed[i].id);
+    }
+    free(parsed);
+    return image;
+}
+
+// Writes an image to the cache. Written to a temporary name and renamed so a
+// concurrent start never maps a partial file.
+static int write_catalog_cache(const char *cache_path, const void *image, size_t size) {
+    char tmp_path[256];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cache_path);
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f) return -1;
+
+    int ok = fwrite(image, size, 1, f) == 1;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp_path, cache_path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+// Maps the cache and attaches the columns to it. src_st may be NULL when the
+// source catalog is missing, in which case any well-formed cache is accepted.
+static int map_catalog_cache(const char *cache_path, const struct stat *src_st) {
+    int fd = open(cache_path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CatalogCacheHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const CatalogCacheHeader *header = map;
+    int valid = memcmp(header->magic, CATALOG_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == CATALOG_CACHE_VERSION &&
+                header->star_bytes == CATALOG_STAR_BYTES &&
+                (size_t)st.st_size == catalog_image_bytes(header->count);
+    if (valid && src_st) {
+        valid = header->source_size == (int64_t)src_st->st_size &&
+                header->source_mtime == (int64_t)src_st->st_mtim.tv_sec &&
+                header->source_mtime_nsec == (uint32_t)src_st->st_mtim.tv_nsec;
+    }
+    if (!valid) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    attach_catalog_image(map, st.st_size, 1);
+    return 0;
+}
+
+static int load_stars() {
+    struct stat src_st;
+    int have_source = stat(HIP_SOURCE_FILE, &src_st) == 0;
+
+    if (map_catalog_cache(HIP_CACHE_FILE, have_source ? &src_st : NULL) == 0) {
+        fprintf(stderr, "Loaded %d stars from %s.\n", num_stars, HIP_CACHE_FILE);
+        return 0;
+    }
+
+    size_t size = 0;
+    void *image = have_source ? build_catalog_image(HIP_SOURCE_FILE, &src_st, &size) : NULL;
+    if (!image) {
+        if (have_source) {
+            fprintf(stderr, "Error: could not read hip_main.dat.\n");
+        } else {
+            fprintf(stderr, "Error: hip_main.dat not found.\n");
+        }
+        return -1;
+    }
+    fprintf(stderr, "Loaded %d stars from Hipparcos catalog.\n", ((CatalogCacheHeader *)image)->count);
+
+    // Prefer serving the columns from the freshly written cache so both paths share pages
+    if (write_catalog_cache(HIP_CACHE_FILE, image, size) == 0 &&
+        map_catalog_cache(HIP_CACHE_FILE, &src_st) == 0) {
+        free(image);
+        return 0;
+    }
+
+    fprintf(stderr, "Warning: could not write star catalog cache %s.\n", HIP_CACHE_FILE);
+    attach_catalog_image(image, size, 0);
+    return 0;
+}
+
+int catalog_count_brighter(double limit) {
+    int lo, hi;
+    double k = floor((limit - MAG_LUT_MIN) / MAG_LUT_STEP);
+    if (k < 0) {
+        lo = 0;
+        hi = mag_lut[0];
+    } else if (k >= MAG_LUT_BINS) {
+        lo = mag_lut[MAG_LUT_BINS];
+        hi = num_stars;
+    } else {
+        lo = mag_lut[(int)k];
+        hi = mag_lut[(int)k + 1];
+    }
+
+    // First index in [lo, hi) fainter than the limit
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (star_catalog.mag[mid] > limit) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+const char *catalog_get_star_id(int i) {
+    const char *id = star_catalog.ids + (size_t)i * CATALOG_ID_LEN;
+    return id[0] ? id : NULL;
+}
+
+Star catalog_get_star(int i) {
+    Star s;
+    s.ra = star_catalog.ra[i];
+    s.dec = star_catalog.dec[i];
+    s.mag = star_catalog.mag[i];
+    s.bv = star_catalog.bv[i];
+    s.id = catalog_get_star_id(i);
+    return s;
+}
+
+int load_catalog() {
+    // 1. Load Stars from Hipparcos (via the binary cache when it is up to date)
+    if (load_stars() != 0) {
+        return -1;
+    }
+    if (star_index_build() != 0) {
+        return -1;
+    }
 
     // 2. Load Constellations from JSON (Same as before)
     json_error_t error;
@@ -137,70 +423,113 @@ int load_catalog() {
         return -1;
     }
 
+    // Size the flat buffers first
+    int total_lines = 0;
+    int total_vertices = 0;
+    for (size_t i = 0; i < json_array_size(features); i++) {
+        json_t *coordinates = json_object_get(json_object_get(json_array_get(features, i), "geometry"), "coordinates");
+        if (!json_is_array(coordinates)) continue;
+        total_lines += json_array_size(coordinates);
+        for (size_t j = 0; j < json_array_size(coordinates); j++) {
+            total_vertices += json_array_size(json_array_get(coordinates, j));
+        }
+    }
+
     num_constellations = json_array_size(features);
-    constellations = malloc(sizeof(Constellation) * num_constellations);
+    constellations = calloc(num_constellations > 0 ? num_constellations : 1, sizeof(Constellation));
+    ConstellationVertices *cv = &constellation_vertices;
+    cv->x = malloc(sizeof(double) * (total_vertices > 0 ? total_vertices : 1));
+    cv->y = malloc(sizeof(double) * (total_vertices > 0 ? total_vertices : 1));
+    cv->z = malloc(sizeof(double) * (total_vertices > 0 ? total_vertices : 1));
+    cv->line_start = malloc(sizeof(int) * (total_lines + 1));
+    if (!constellations || !cv->x || !cv->y || !cv->z || !cv->line_start) {
+        fprintf(stderr, "Error: could not allocate constellation lines.\n");
+        json_decref(root);
+        return -1;
+    }
+    cv->num_lines = 0;
+    cv->num_vertices = 0;
 
     for(int i = 0; i < num_constellations; i++) {
         json_t *feature = json_array_get(features, i);
         json_t *geometry = json_object_get(feature, "geometry");
         json_t *coordinates = json_object_get(geometry, "coordinates");
         json_t *id_obj = json_object_get(feature, "id");
+        Constellation *c = &constellations[i];
 
         const char *id_str = json_string_value(id_obj);
-        constellations[i].id = malloc(32);
-        if (constellations[i].id) {
-            if(id_str) {
-                strncpy(constellations[i].id, id_str, 31);
-                constellations[i].id[31] = '\0';
-            } else {
-                strcpy(constellations[i].id, "UNK");
+        strncpy(c->id, id_str ? id_str : "UNK", sizeof(c->id) - 1);
+
+        c->first_line = cv->num_lines;
+        c->num_lines = 0;
+        int first_vertex = cv->num_vertices;
+
+        if (json_is_array(coordinates)) {
+            int num_lines = json_array_size(coordinates);
+            for(int j = 0; j < num_lines; j++) {
+                json_t *line = json_array_get(coordinates, j);
+                int len = json_array_size(line);
+                cv->line_start[cv->num_lines++] = cv->num_vertices;
+
+                for(int k = 0; k < len; k++) {
+                    json_t *point = json_array_get(line, k);
+                    double ra = json_number_value(json_array_get(point, 0)) * (M_PI / 180.0);
+                    double dec = json_number_value(json_array_get(point, 1)) * (M_PI / 180.0);
+                    int v = cv->num_vertices++;
+                    cv->x[v] = cos(dec) * cos(ra);
+                    cv->y[v] = cos(dec) * sin(ra);
+                    cv->z[v] = sin(dec);
+                }
             }
+            c->num_lines = num_lines;
         }
 
-        if(!json_is_array(coordinates)) continue;
-
-        int num_lines = json_array_size(coordinates);
-        constellations[i].num_lines = num_lines;
-        constellations[i].line_lengths = malloc(sizeof(int) * num_lines);
-        constellations[i].lines = malloc(sizeof(double*) * num_lines);
-
-        for(int j = 0; j < num_lines; j++) {
-            json_t *line = json_array_get(coordinates, j);
-            int len = json_array_size(line);
-            constellations[i].line_lengths[j] = len;
-            constellations[i].lines[j] = malloc(sizeof(double) * len * 2);
-
-            for(int k = 0; k < len; k++) {
-                json_t *point = json_array_get(line, k);
-                double ra = json_number_value(json_array_get(point, 0));
-                double dec = json_number_value(json_array_get(point, 1));
-                constellations[i].lines[j][k*2] = ra;
-                constellations[i].lines[j][k*2+1] = dec;
-            }
+        // Bounding cap around the normalized mean of the vertices
+        double sx = 0, sy = 0, sz = 0;
+        for (int v = first_vertex; v < cv->num_vertices; v++) {
+            sx += cv->x[v]; sy += cv->y[v]; sz += cv->z[v];
+        }
+        double norm = sqrt(sx*sx + sy*sy + sz*sz);
+        if (norm < 1e-9) {
+            sx = 0; sy = 0; sz = 1; norm = 1; // Empty or degenerate figure
         }
+        c->center[0] = sx / norm;
+        c->center[1] = sy / norm;
+        c->center[2] = sz / norm;
+
+        double min_dot = 1.0;
+        for (int v = first_vertex; v < cv->num_vertices; v++) {
+            double dot = c->center[0] * cv->x[v] + c->center[1] * cv->y[v] + c->center[2] * cv->z[v];
+            if (dot < min_dot) min_dot = dot;
+        }
+        if (min_dot < -1.0) min_dot = -1.0;
+        c->cap_radius = acos(min_dot) * 180.0 / M_PI;
     }
+    cv->line_start[cv->num_lines] = cv->num_vertices;
 
     json_decref(root);
     return 0;
 }
 
 void free_catalog() {
-    if (stars) {
-        for (int i=0; i<num_stars; i++) {
-            if (stars[i].id) free((void*)stars[i].id);
-        }
-        free(stars);
-    }
+    star_index_free();
 
-    if (constellations) {
-        for (int i=0; i<num_constellations; i++) {
-            for (int j=0; j<constellations[i].num_lines; j++) {
-                free(constellations[i].lines[j]);
-            }
-            free(constellations[i].lines);
-            free(constellations[i].line_lengths);
-            if (constellations[i].id) free(constellations[i].id);
-        }
-        free(constellations);
+    if (catalog_image) {
+        if (catalog_image_mapped) munmap(catalog_image, catalog_image_size);
+        else free(catalog_image);
+        catalog_image = NULL;
+        catalog_image_size = 0;
+        memset(&star_catalog, 0, sizeof(star_catalog));
+        num_stars = 0;
     }
+
+    free(constellations);
+    constellations = NULL;
+    num_constellations = 0;
+
+    free(constellation_vertices.x);
+    free(constellation_vertices.y);
+    free(constellation_vertices.z);
+    free(constellation_vertices.line_start);
+    memset(&constellation_vertices, 0, sizeof(constellation_vertices));
 }
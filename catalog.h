@@ -9,23 +9,59 @@ typedef struct {
     double mag;
     double bv; // B-V Color Index
     const char *id; // Can be null or numeric id as string
-} Star;
+} Star; // Single star view, see catalog_get_star()
+
+#define CATALOG_ID_LEN 16
+
+// Star storage (structure of arrays). Index i refers to the same star in every
+// column; the columns are read-only once loaded and sorted by increasing
+// magnitude, so any magnitude cut is a prefix of the arrays.
+typedef struct {
+    const double *x; // Equatorial unit vector: x towards RA 0h,
+    const double *y; // y towards RA 6h,
+    const double *z; // z towards the north celestial pole
+    const double *ra; // degrees
+    const double *dec; // degrees
+    const double *mag; // Kept exact so cuts match the parsed catalog
+    const float *bv; // B-V Color Index
+    const char *ids; // num_stars fixed-width CATALOG_ID_LEN strings, "" if none
+    const unsigned char *color; // Quantized B-V (see star_color_index())
+} StarCatalog;
+
+// Constellation figures share one flat vertex buffer of equatorial unit vectors.
+// Polyline j covers vertices [line_start[j], line_start[j + 1]); figure i owns
+// polylines [first_line, first_line + num_lines), whose vertices are contiguous.
+typedef struct {
+    double *x, *y, *z;
+    int num_vertices;
+    int *line_start; // num_lines + 1 entries
+    int num_lines;
+} ConstellationVertices;
 
 typedef struct {
-    char *id;
+    char id[32];
+    int first_line;
     int num_lines;
-    int *line_lengths; // Array of size num_lines
-    double **lines; // Array of array of points. points are stored as ra1, dec1, ra2, dec2...
+    double center[3]; // Unit vector: label position and centre of the bounding cap
+    double cap_radius; // degrees; every vertex of the figure lies within it
 } Constellation;
 
 // Global Arrays
-extern Star *stars;
+extern StarCatalog star_catalog;
 extern int num_stars;
 
 extern Constellation *constellations;
 extern int num_constellations;
+extern ConstellationVertices constellation_vertices;
 
 int load_catalog();
 void free_catalog();
 
+// Number of stars with mag <= limit, i.e. the length of the prefix passing the cut
+int catalog_count_brighter(double limit);
+
+// Row accessors for code that wants one star at a time
+Star catalog_get_star(int i);
+const char *catalog_get_star_id(int i); // NULL if the star has no ID
+
 #endif
@@ -2,7 +2,8 @@
 #include "target_list.h"
 #include <math.h>
 #include <stdio.h>
-#include <time.h> // For mktime
+#include <stdlib.h>
+#include <string.h>
 
 static Location *current_loc;
 static DateTime *current_dt;
@@ -12,70 +13,203 @@ static TimeSelectedCallback time_callback = NULL;
 static ElevationHoverCallback hover_callback = NULL;
 static Target *highlighted_target = NULL;
 
+// Curves are sampled every 10 minutes over the 16 hour window around midnight
+#define CURVE_SAMPLES 97
+#define CURVE_SAMPLE_HOURS(k) (-8.0 + (k) * 0.166666)
+
 // Helper state to store last motion coordinates for drawing the crosshair/line
 static int last_motion_valid = 0;
 static double last_motion_x = 0;
 static double last_motion_y = 0;
 static double last_motion_alt = 0;
 
+// Curve cache: altitude samples of the Sun, the Moon and every target for one
+// night and site. Targets are kept in list order (all lists, visible or not);
+// when the target lists change, entries whose target and position are
+// unchanged are carried over instead of resampled.
+typedef struct {
+    const Target *target;
+    double ra, dec;
+    double alt[CURVE_SAMPLES];
+} TargetCurve;
+
+typedef struct {
+    JulianDay center_jd;
+    Location loc;
+} CurveNightKey;
+
+static CurveNightKey curve_night_key;
+static int curve_night_valid = 0;
+static unsigned long curve_targets_revision = 0;
+static ObserverFrame sample_frames[CURVE_SAMPLES];
+static double sun_curve[CURVE_SAMPLES]; // Also the profile behind the twilight shading
+static double moon_curve[CURVE_SAMPLES];
+static JulianDay sunrise_jd = -1; // -1: no crossing inside the graph
+static JulianDay sunset_jd = -1;
+static TargetCurve *target_curves = NULL;
+static int target_curve_count = 0;
+
+// Retained graph layer: everything but the cursor line and its label. Target
+// edits reach the key through the target list revision.
+typedef struct {
+    int width, height, scale;
+    Location loc;
+    DateTime dt;
+    const Target *highlighted;
+    unsigned long targets_revision;
+} GraphLayerKey;
+
+static cairo_surface_t *graph_layer = NULL;
+static GraphLayerKey graph_layer_key;
+
 void elevation_view_set_highlighted_target(Target *target) {
     highlighted_target = target;
     elevation_view_redraw();
 }
 
-// Helper to add hours to a DateTime
-static DateTime add_hours(DateTime dt, double hours) {
-    struct tm t = {0};
-    t.tm_year = dt.year - 1900;
-    t.tm_mon = dt.month - 1;
-    t.tm_mday = dt.day;
-    t.tm_hour = dt.hour;
-    t.tm_min = dt.minute;
-    t.tm_sec = (int)dt.second;
-    t.tm_isdst = -1;
-
-    time_t time_val = mktime(&t);
-    time_val += (time_t)(hours * 3600);
-
-    struct tm *new_t = localtime(&time_val);
-    DateTime res = dt;
-    res.year = new_t->tm_year + 1900;
-    res.month = new_t->tm_mon + 1;
-    res.day = new_t->tm_mday;
-    res.hour = new_t->tm_hour;
-    res.minute = new_t->tm_min;
-    res.second = new_t->tm_sec;
-    return res;
-}
-
-static double get_hour_diff(DateTime t1, DateTime t2) {
-    struct tm tm1 = {0}, tm2 = {0};
-    tm1.tm_year = t1.year - 1900; tm1.tm_mon = t1.month - 1; tm1.tm_mday = t1.day;
-    tm1.tm_hour = t1.hour; tm1.tm_min = t1.minute; tm1.tm_sec = (int)t1.second;
-    tm1.tm_isdst = -1;
-
-    tm2.tm_year = t2.year - 1900; tm2.tm_mon = t2.month - 1; tm2.tm_mday = t2.day;
-    tm2.tm_hour = t2.hour; tm2.tm_min = t2.minute; tm2.tm_sec = (int)t2.second;
-    tm2.tm_isdst = -1;
-
-    double diff = difftime(mktime(&tm1), mktime(&tm2));
-    return diff / 3600.0;
-}
-
-static DateTime get_nearest_midnight(DateTime dt) {
+// The graph spans 8 hours either side of the local midnight nearest to dt.
+// All sampling is done in Julian days from there.
+static JulianDay get_nearest_midnight(DateTime dt) {
     DateTime midnight = dt;
     midnight.hour = 0;
     midnight.minute = 0;
     midnight.second = 0;
 
+    JulianDay jd = get_julian_day(midnight);
     if (dt.hour >= 12) {
         // Move to next day
-        return add_hours(midnight, 24.0);
+        jd += 1.0;
     }
-    return midnight;
+    return jd;
 }
 
-static void on_draw(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer data) {
+static JulianDay graph_time(JulianDay center_jd, double offset_hours) {
+    return center_jd + offset_hours / HOURS_PER_DAY;
+}
+
+// Sun horizon crossings are bracketed by two curve samples (10 minutes) and
+// bisected down to about a second
+#define SUN_CROSSING_ITERATIONS 10
+
+static JulianDay refine_sun_crossing(JulianDay lo, double alt_lo, JulianDay hi) {
+    ObserverFrame frame = sample_frames[0];
+    for (int it = 0; it < SUN_CROSSING_ITERATIONS; it++) {
+        JulianDay mid = 0.5 * (lo + hi);
+        observer_frame_advance_jd(&frame, *current_loc, mid);
+        double alt, az;
+        observer_frame_get_sun_position(&frame, &alt, &az);
+        if ((alt < 0) == (alt_lo < 0)) lo = mid;
+        else hi = mid;
+    }
+    return 0.5 * (lo + hi);
+}
+
+// Background brightness for a Sun altitude: dark below -18, bright above 0
+static double twilight_brightness(double sun_alt) {
+    if (sun_alt <= -18.0) return 0.1;
+    if (sun_alt >= 0.0) return 0.9;
+    double f = (sun_alt + 18.0) / 18.0;
+    return 0.1 + f * 0.8;
+}
+
+static void sample_target_curve(TargetCurve *curve, const Target *tgt) {
+    curve->target = tgt;
+    curve->ra = tgt->ra;
+    curve->dec = tgt->dec;
+    for (int k = 0; k < CURVE_SAMPLES; k++) {
+        double az;
+        observer_frame_get_horizontal(&sample_frames[k], tgt->ra, tgt->dec, &curve->alt[k], &az);
+    }
+}
+
+static int curve_matches(const TargetCurve *curve, const Target *tgt) {
+    return curve->target == tgt && curve->ra == tgt->ra && curve->dec == tgt->dec;
+}
+
+// Brings the curve cache up to date for the night around center_jd
+static void update_curve_cache(JulianDay center_jd) {
+    CurveNightKey key;
+    memset(&key, 0, sizeof(key));
+    key.center_jd = center_jd;
+    key.loc = *current_loc;
+
+    int new_night = !curve_night_valid || memcmp(&key, &curve_night_key, sizeof(key)) != 0;
+    unsigned long revision = target_list_get_revision();
+    if (!new_night && revision == curve_targets_revision) return;
+
+    if (new_night) {
+        // One observer frame per curve sample, shared by the Sun, Moon and every target
+        observer_frame_init_jd(&sample_frames[0], *current_loc, graph_time(center_jd, CURVE_SAMPLE_HOURS(0)));
+        for (int k = 1; k < CURVE_SAMPLES; k++) {
+            sample_frames[k] = sample_frames[0];
+            observer_frame_advance_jd(&sample_frames[k], *current_loc, graph_time(center_jd, CURVE_SAMPLE_HOURS(k)));
+        }
+        for (int k = 0; k < CURVE_SAMPLES; k++) {
+            double az;
+            observer_frame_get_sun_position(&sample_frames[k], &sun_curve[k], &az);
+            observer_frame_get_moon_position(&sample_frames[k], &moon_curve[k], &az);
+        }
+
+        sunrise_jd = -1;
+        sunset_jd = -1;
+        for (int k = 1; k < CURVE_SAMPLES; k++) {
+            double prev = sun_curve[k - 1];
+            double cur = sun_curve[k];
+            if ((prev < 0 && cur >= 0) || (prev > 0 && cur <= 0)) {
+                JulianDay jd = refine_sun_crossing(sample_frames[k - 1].jd, prev, sample_frames[k].jd);
+                if (cur >= 0) sunrise_jd = jd;
+                else sunset_jd = jd;
+            }
+        }
+    }
+
+    int total = 0;
+    int num_lists = target_list_get_list_count();
+    for (int l = 0; l < num_lists; l++) {
+        total += target_list_get_count(target_list_get_list_by_index(l));
+    }
+
+    TargetCurve *curves = malloc(sizeof(TargetCurve) * (total > 0 ? total : 1));
+    if (!curves) {
+        curve_night_valid = 0;
+        return;
+    }
+
+    int n = 0;
+    for (int l = 0; l < num_lists; l++) {
+        TargetList *tl = target_list_get_list_by_index(l);
+        int cnt = target_list_get_count(tl);
+        for (int i = 0; i < cnt; i++, n++) {
+            Target *tgt = target_list_get_target(tl, i);
+            int reused = 0;
+            if (!new_night) {
+                // Appends keep positions; otherwise look the target up
+                if (n < target_curve_count && curve_matches(&target_curves[n], tgt)) {
+                    curves[n] = target_curves[n];
+                    reused = 1;
+                } else {
+                    for (int m = 0; m < target_curve_count; m++) {
+                        if (curve_matches(&target_curves[m], tgt)) {
+                            curves[n] = target_curves[m];
+                            reused = 1;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (!reused) sample_target_curve(&curves[n], tgt);
+        }
+    }
+
+    free(target_curves);
+    target_curves = curves;
+    target_curve_count = total;
+    curve_night_key = key;
+    curve_night_valid = 1;
+    curve_targets_revision = revision;
+}
+
+static void draw_graph_layer(cairo_t *cr, int width, int height) {
     double margin_left = 50;
     double margin_bottom = 30;
     double margin_top = 20; // Increased for Sunrise/Sunset Labels
@@ -88,51 +222,41 @@ static void on_draw(GtkDrawingArea *area, cairo_t *cr, int width, int height, gp
     #define DEG_TO_Y(deg) (margin_top + (90.0 - (deg)) / 100.0 * graph_h)
 
     // Determine Center Time (Nearest Midnight)
-    DateTime center_time = get_nearest_midnight(*current_dt);
+    JulianDay center_jd = get_nearest_midnight(*current_dt);
+
+    update_curve_cache(center_jd);
 
-    // Background Gradient (Twilight/Day/Night)
-    // Draw vertical stripes for each pixel column
+    // Background (Twilight/Day/Night): a horizontal gradient through the Sun
+    // altitude profile, with extra stops where the shading saturates
     double x_start = margin_left;
     double x_end = width - margin_right;
-
-    // Scan for Sunrise/Sunset
-    double sunrise_x = -1, sunset_x = -1;
-
-    for (double x = x_start; x < x_end; x += 1.0) {
-        double ratio = (x - margin_left) / graph_w;
-        double offset_hours = ratio * 16.0 - 8.0;
-        DateTime t = add_hours(center_time, offset_hours);
-
-        double sun_alt, sun_az;
-        get_sun_position(*current_loc, t, &sun_alt, &sun_az);
-
-        double brightness = 0.0;
-        if (sun_alt <= -18.0) {
-            brightness = 0.1; // Dark
-        } else if (sun_alt >= 0.0) {
-            brightness = 0.9; // Bright
-        } else {
-            // Interpolate -18 to 0
-            double f = (sun_alt + 18.0) / 18.0;
-            brightness = 0.1 + f * 0.8;
-        }
-
-        cairo_set_source_rgb(cr, brightness, brightness, brightness);
-        cairo_rectangle(cr, x, margin_top, 1.0, graph_h);
-        cairo_fill(cr);
-
-        // Detect 0 crossing
-        if (x > x_start) {
-            double prev_ratio = (x - 1.0 - margin_left) / graph_w;
-            double prev_offset = prev_ratio * 16.0 - 8.0;
-            DateTime prev_t = add_hours(center_time, prev_offset);
-            double prev_sun_alt, temp_az;
-            get_sun_position(*current_loc, prev_t, &prev_sun_alt, &temp_az);
-
-            if (prev_sun_alt < 0 && sun_alt >= 0) sunrise_x = x;
-            if (prev_sun_alt > 0 && sun_alt <= 0) sunset_x = x;
+    cairo_pattern_t *sky = cairo_pattern_create_linear(x_start, 0, x_end, 0);
+    for (int k = 0; k < CURVE_SAMPLES; k++) {
+        double offset = (CURVE_SAMPLE_HOURS(k) + 8.0) / 16.0;
+        if (k > 0) {
+            double prev_offset = (CURVE_SAMPLE_HOURS(k - 1) + 8.0) / 16.0;
+            double a0 = sun_curve[k - 1], a1 = sun_curve[k];
+            double kinks[2] = {-18.0, 0.0};
+            if (a1 < a0) { kinks[0] = 0.0; kinks[1] = -18.0; }
+            for (int q = 0; q < 2; q++) {
+                if ((a0 - kinks[q]) * (a1 - kinks[q]) < 0) {
+                    double f = (kinks[q] - a0) / (a1 - a0);
+                    double b = twilight_brightness(kinks[q]);
+                    cairo_pattern_add_color_stop_rgb(sky, prev_offset + f * (offset - prev_offset), b, b, b);
+                }
+            }
         }
+        double b = twilight_brightness(sun_curve[k]);
+        cairo_pattern_add_color_stop_rgb(sky, offset, b, b, b);
     }
+    cairo_set_source(cr, sky);
+    cairo_rectangle(cr, x_start, margin_top, x_end - x_start, graph_h);
+    cairo_fill(cr);
+    cairo_pattern_destroy(sky);
+
+    double sunrise_x = -1, sunset_x = -1;
+    if (sunrise_jd > 0) sunrise_x = margin_left + ((sunrise_jd - center_jd) * HOURS_PER_DAY + 8.0) / 16.0 * graph_w;
+    if (sunset_jd > 0) sunset_x = margin_left + ((sunset_jd - center_jd) * HOURS_PER_DAY + 8.0) / 16.0 * graph_w;
 
     // Draw Sunrise/Sunset Lines and Labels
     cairo_set_source_rgb(cr, 1.0, 0.5, 0.0); // Orange
@@ -208,7 +332,7 @@ static void on_draw(GtkDrawingArea *area, cairo_t *cr, int width, int height, gp
         cairo_stroke(cr);
 
         if (h % 2 == 0) {
-            DateTime t = add_hours(center_time, h);
+            DateTime t = datetime_from_julian_day(graph_time(center_jd, h), current_dt->timezone_offset);
             char buf[10];
             sprintf(buf, "%02d:00", t.hour);
             cairo_text_extents_t extents;
@@ -219,7 +343,7 @@ static void on_draw(GtkDrawingArea *area, cairo_t *cr, int width, int height, gp
     }
 
     // "Now" Line (Selected Time)
-    double diff_now = get_hour_diff(*current_dt, center_time);
+    double diff_now = (get_julian_day(*current_dt) - center_jd) * HOURS_PER_DAY;
     if (diff_now >= -8 && diff_now <= 8) {
         double x_now = margin_left + (diff_now + 8) / 16.0 * graph_w;
         cairo_set_source_rgb(cr, 0, 0, 1); // Blue
@@ -229,25 +353,6 @@ static void on_draw(GtkDrawingArea *area, cairo_t *cr, int width, int height, gp
         cairo_stroke(cr);
     }
 
-    // Cursor Horizontal Line & Label
-    if (last_motion_valid) {
-        cairo_set_source_rgb(cr, 0.5, 0.5, 0.5); // Grey
-        cairo_set_line_width(cr, 1.0);
-        cairo_set_dash(cr, (double[]){4.0, 4.0}, 2, 0); // Dashed
-
-        cairo_move_to(cr, margin_left, last_motion_y);
-        cairo_line_to(cr, width - margin_right, last_motion_y);
-        cairo_stroke(cr);
-
-        cairo_set_dash(cr, NULL, 0, 0); // Reset dash
-
-        char elev_buf[16];
-        snprintf(elev_buf, 16, "%.1f", last_motion_alt);
-        cairo_set_source_rgb(cr, 1.0, 1.0, 1.0); // White text
-        cairo_move_to(cr, width - margin_right - 30, last_motion_y - 5);
-        cairo_show_text(cr, elev_buf);
-    }
-
     cairo_set_line_width(cr, 1.5);
 
     // Plot Objects (Sun, Moon)
@@ -255,36 +360,33 @@ static void on_draw(GtkDrawingArea *area, cairo_t *cr, int width, int height, gp
         if (obj == 0) cairo_set_source_rgb(cr, 1, 0.8, 0); // Sun Yellow
         else cairo_set_source_rgb(cr, 0.8, 0.8, 0.8); // Moon White/Grey
 
-        int first = 1;
-        for (double h = -8.0; h <= 8.0; h += 0.166666) {
-            DateTime t = add_hours(center_time, h);
-
-            double alt = 0, az = 0;
-            if (obj == 0) get_sun_position(*current_loc, t, &alt, &az);
-            else get_moon_position(*current_loc, t, &alt, &az);
-
+        const double *curve = (obj == 0) ? sun_curve : moon_curve;
+        for (int k = 0; k < CURVE_SAMPLES; k++) {
+            double h = CURVE_SAMPLE_HOURS(k);
             double x = margin_left + (h + 8.0) / 16.0 * graph_w;
-            double y = DEG_TO_Y(alt);
+            double y = DEG_TO_Y(curve[k]);
 
-            if (first) {
-                cairo_move_to(cr, x, y);
-                first = 0;
-            } else {
-                cairo_line_to(cr, x, y);
-            }
+            if (k == 0) cairo_move_to(cr, x, y);
+            else cairo_line_to(cr, x, y);
         }
         cairo_stroke(cr);
     }
 
-    // Plot Targets
+    // Plot Targets. Curves are indexed in list order across all lists.
     int num_lists = target_list_get_list_count();
+    int n = 0;
     for (int l = 0; l < num_lists; l++) {
         TargetList *tl = target_list_get_list_by_index(l);
-        if (!target_list_is_visible(tl)) continue;
-
         int cnt = target_list_get_count(tl);
-        for (int i=0; i<cnt; i++) {
+        if (!target_list_is_visible(tl)) {
+            n += cnt;
+            continue;
+        }
+
+        for (int i=0; i<cnt; i++, n++) {
             Target *tgt = target_list_get_target(tl, i);
+            if (n >= target_curve_count) break; // Cache could not be allocated
+            const TargetCurve *curve = &target_curves[n];
 
             if (tgt == highlighted_target) {
                 cairo_set_source_rgb(cr, 0.0, 1.0, 1.0); // Cyan
@@ -294,27 +396,78 @@ static void on_draw(GtkDrawingArea *area, cairo_t *cr, int width, int height, gp
                 cairo_set_line_width(cr, 1.5);
             }
 
-            int first = 1;
-            for (double h = -8.0; h <= 8.0; h += 0.166666) {
-                DateTime t = add_hours(center_time, h);
-                double alt, az;
-                get_horizontal_coordinates(tgt->ra, tgt->dec, *current_loc, t, &alt, &az);
-
+            for (int k = 0; k < CURVE_SAMPLES; k++) {
+                double h = CURVE_SAMPLE_HOURS(k);
                 double x = margin_left + (h + 8.0) / 16.0 * graph_w;
-                double y = DEG_TO_Y(alt);
+                double y = DEG_TO_Y(curve->alt[k]);
 
-                if (first) {
-                    cairo_move_to(cr, x, y);
-                    first = 0;
-                } else {
-                    cairo_line_to(cr, x, y);
-                }
+                if (k == 0) cairo_move_to(cr, x, y);
+                else cairo_line_to(cr, x, y);
             }
             cairo_stroke(cr);
         }
     }
 }
 
+// Cursor line and elevation label, drawn over the retained layer
+static void draw_cursor_overlay(cairo_t *cr, int width, int height) {
+    double margin_left = 50;
+    double margin_right = 10;
+
+    // Cursor Horizontal Line & Label
+    if (last_motion_valid) {
+        cairo_set_source_rgb(cr, 0.5, 0.5, 0.5); // Grey
+        cairo_set_line_width(cr, 1.0);
+        cairo_set_dash(cr, (double[]){4.0, 4.0}, 2, 0); // Dashed
+
+        cairo_move_to(cr, margin_left, last_motion_y);
+        cairo_line_to(cr, width - margin_right, last_motion_y);
+        cairo_stroke(cr);
+
+        cairo_set_dash(cr, NULL, 0, 0); // Reset dash
+
+        char elev_buf[16];
+        snprintf(elev_buf, 16, "%.1f", last_motion_alt);
+        cairo_set_source_rgb(cr, 1.0, 1.0, 1.0); // White text
+        cairo_move_to(cr, width - margin_right - 30, last_motion_y - 5);
+        cairo_show_text(cr, elev_buf);
+    }
+}
+
+static void on_draw(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer data) {
+    int scale = gtk_widget_get_scale_factor(GTK_WIDGET(area));
+    if (scale < 1) scale = 1;
+
+    GraphLayerKey key;
+    memset(&key, 0, sizeof(key));
+    key.width = width;
+    key.height = height;
+    key.scale = scale;
+    key.loc = *current_loc;
+    key.dt = *current_dt;
+    key.highlighted = highlighted_target;
+    key.targets_revision = target_list_get_revision();
+
+    if (!graph_layer || memcmp(&key, &graph_layer_key, sizeof(key)) != 0) {
+        if (!graph_layer || key.width != graph_layer_key.width || key.height != graph_layer_key.height || key.scale != graph_layer_key.scale) {
+            if (graph_layer) cairo_surface_destroy(graph_layer);
+            graph_layer = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width * scale, height * scale);
+            cairo_surface_set_device_scale(graph_layer, scale, scale);
+        }
+
+        cairo_t *layer_cr = cairo_create(graph_layer);
+        draw_graph_layer(layer_cr, width, height);
+        cairo_destroy(layer_cr);
+
+        graph_layer_key = key;
+    }
+
+    cairo_set_source_surface(cr, graph_layer, 0, 0);
+    cairo_paint(cr);
+
+    draw_cursor_overlay(cr, width, height);
+}
+
 static void on_leave(GtkEventControllerMotion *controller, gpointer user_data) {
     if (status_label) gtk_label_set_text(status_label, "");
     last_motion_valid = 0;
@@ -351,8 +504,8 @@ static void on_motion(GtkEventControllerMotion *controller, double x, double y,
     double ratio = (x - margin_left) / graph_w;
     double offset_hours = ratio * 16.0 - 8.0;
 
-    DateTime center_time = get_nearest_midnight(*current_dt);
-    DateTime t = add_hours(center_time, offset_hours);
+    JulianDay center_jd = get_nearest_midnight(*current_dt);
+    DateTime t = datetime_from_julian_day(graph_time(center_jd, offset_hours), current_dt->timezone_offset);
 
     double alt = 90.0 - (y - margin_top) / graph_h * 100.0;
 
@@ -383,8 +536,8 @@ static void update_time_from_x(double x, int width) {
     double ratio = (x - margin_left) / graph_w;
     double offset_hours = ratio * 16.0 - 8.0;
 
-    DateTime center_time = get_nearest_midnight(*current_dt);
-    DateTime new_dt = add_hours(center_time, offset_hours);
+    JulianDay center_jd = get_nearest_midnight(*current_dt);
+    DateTime new_dt = datetime_from_julian_day(graph_time(center_jd, offset_hours), current_dt->timezone_offset);
 
     time_callback(new_dt);
 }
@@ -0,0 +1,298 @@
+#include "ephemeris.h"
+#include <libnova/solar.h>
+#include <libnova/lunar.h>
+#include <libnova/mercury.h>
+#include <libnova/venus.h>
+#include <libnova/mars.h>
+#include <libnova/jupiter.h>
+#include <libnova/saturn.h>
+#include <libnova/uranus.h>
+#include <libnova/neptune.h>
+#include <libnova/rise_set.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#define EPHEMERIS_COEFFS 12 // Chebyshev terms per component (degree 11)
+#define EPHEMERIS_SEGMENTS 4 // Fitted segments kept per body
+#define EPHEMERIS_MAX_HALVINGS 6
+#define RST_CACHE_SIZE 16 // A few dates times the handful of horizons in use
+
+// One fitted segment: the unit vector (x towards RA 0, z towards the pole)
+// over [start, start + span) as Chebyshev series in t = -1..1
+typedef struct {
+    int valid;
+    JulianDay start;
+    double span;
+    double coeff[3][EPHEMERIS_COEFFS];
+    unsigned long last_use;
+} EphemerisSegment;
+
+typedef struct {
+    double span; // Length of new segments (days), halved when a fit misses the tolerance
+    int halvings;
+    double max_error;
+    EphemerisSegment segments[EPHEMERIS_SEGMENTS];
+} EphemerisState;
+
+// Initial segment lengths (days). The Moon moves ~13 deg/day; the rest are slow
+// enough that a few days per segment keep the fit far below the tolerance.
+static const double base_span[EPHEMERIS_BODY_COUNT] = {
+    8.0,  // Sun
+    1.0,  // Moon
+    4.0,  // Mercury
+    8.0,  // Venus
+    8.0,  // Mars
+    16.0, // Jupiter
+    16.0, // Saturn
+    16.0, // Uranus
+    16.0  // Neptune
+};
+
+typedef struct {
+    int valid;
+    EphemerisBody body;
+    double lat, lon;
+    JulianDay jd_noon;
+    double horizon;
+    int status;
+    struct ln_rst_time rst;
+    unsigned long last_use;
+} RstEntry;
+
+static EphemerisState states[EPHEMERIS_BODY_COUNT];
+static RstEntry rst_cache[RST_CACHE_SIZE];
+static int states_ready = 0;
+static unsigned long use_clock = 0;
+static pthread_mutex_t ephemeris_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Called with ephemeris_lock held
+static void exact_equ(EphemerisBody body, JulianDay jd, double *ra, double *dec) {
+    struct ln_equ_posn equ = {0, 0};
+    switch (body) {
+        case EPHEMERIS_SUN:     ln_get_solar_equ_coords(jd, &equ); break;
+        case EPHEMERIS_MOON:    ln_get_lunar_equ_coords(jd, &equ); break;
+        case EPHEMERIS_MERCURY: ln_get_mercury_equ_coords(jd, &equ); break;
+        case EPHEMERIS_VENUS:   ln_get_venus_equ_coords(jd, &equ); break;
+        case EPHEMERIS_MARS:    ln_get_mars_equ_coords(jd, &equ); break;
+        case EPHEMERIS_JUPITER: ln_get_jupiter_equ_coords(jd, &equ); break;
+        case EPHEMERIS_SATURN:  ln_get_saturn_equ_coords(jd, &equ); break;
+        case EPHEMERIS_URANUS:  ln_get_uranus_equ_coords(jd, &equ); break;
+        case EPHEMERIS_NEPTUNE: ln_get_neptune_equ_coords(jd, &equ); break;
+        default: break;
+    }
+    *ra = equ.ra;
+    *dec = equ.dec;
+}
+
+void ephemeris_get_equ_exact(EphemerisBody body, JulianDay jd, double *ra, double *dec) {
+    pthread_mutex_lock(&ephemeris_lock);
+    exact_equ(body, jd, ra, dec);
+    pthread_mutex_unlock(&ephemeris_lock);
+}
+
+static void exact_vector(EphemerisBody body, JulianDay jd, double v[3]) {
+    double ra, dec;
+    exact_equ(body, jd, &ra, &dec);
+    double ra_rad = ra * (M_PI / 180.0);
+    double dec_rad = dec * (M_PI / 180.0);
+    v[0] = cos(dec_rad) * cos(ra_rad);
+    v[1] = cos(dec_rad) * sin(ra_rad);
+    v[2] = sin(dec_rad);
+}
+
+// Clenshaw summation of c[0]/2 + sum c[j] T_j(t)
+static double chebyshev_eval(const double *c, double t) {
+    double b1 = 0.0, b2 = 0.0;
+    for (int j = EPHEMERIS_COEFFS - 1; j >= 1; j--) {
+        double b0 = 2.0 * t * b1 - b2 + c[j];
+        b2 = b1;
+        b1 = b0;
+    }
+    return t * b1 - b2 + 0.5 * c[0];
+}
+
+static void segment_vector(const EphemerisSegment *seg, JulianDay jd, double v[3]) {
+    double t = 2.0 * (jd - seg->start) / seg->span - 1.0;
+    for (int c = 0; c < 3; c++) {
+        v[c] = chebyshev_eval(seg->coeff[c], t);
+    }
+}
+
+// Angle (degrees) between a fitted and an exact unit vector
+static double vector_error(const double fit[3], const double exact[3]) {
+    double n = sqrt(fit[0] * fit[0] + fit[1] * fit[1] + fit[2] * fit[2]);
+    double d2 = 0.0;
+    for (int c = 0; c < 3; c++) {
+        double d = fit[c] / n - exact[c];
+        d2 += d * d;
+    }
+    return 2.0 * asin(fmin(1.0, sqrt(d2) / 2.0)) * (180.0 / M_PI);
+}
+
+// Interpolates at the Chebyshev nodes and returns the largest error against
+// libnova at the extrema of T_n, where the truncation error peaks
+static double fit_segment(EphemerisSegment *seg, EphemerisBody body, JulianDay start, double span) {
+    double samples[EPHEMERIS_COEFFS][3];
+    for (int k = 0; k < EPHEMERIS_COEFFS; k++) {
+        double t = cos(M_PI * (k + 0.5) / EPHEMERIS_COEFFS);
+        exact_vector(body, start + 0.5 * span * (t + 1.0), samples[k]);
+    }
+
+    seg->start = start;
+    seg->span = span;
+    for (int c = 0; c < 3; c++) {
+        for (int j = 0; j < EPHEMERIS_COEFFS; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < EPHEMERIS_COEFFS; k++) {
+                sum += samples[k][c] * cos(M_PI * j * (k + 0.5) / EPHEMERIS_COEFFS);
+            }
+            seg->coeff[c][j] = 2.0 * sum / EPHEMERIS_COEFFS;
+        }
+    }
+
+    double max_error = 0.0;
+    for (int m = 0; m <= EPHEMERIS_COEFFS; m++) {
+        double t = cos(M_PI * m / EPHEMERIS_COEFFS);
+        JulianDay jd = start + 0.5 * span * (t + 1.0);
+        double fit[3], exact[3];
+        segment_vector(seg, jd, fit);
+        exact_vector(body, jd, exact);
+        double err = vector_error(fit, exact);
+        if (err > max_error) max_error = err;
+    }
+    return max_error;
+}
+
+// Returns the segment covering jd, fitting one in place of the least recently
+// used if needed. Called with ephemeris_lock held.
+static const EphemerisSegment *find_segment(EphemerisBody body, JulianDay jd) {
+    EphemerisState *state = &states[body];
+    use_clock++;
+
+    EphemerisSegment *victim = &state->segments[0];
+    for (int i = 0; i < EPHEMERIS_SEGMENTS; i++) {
+        EphemerisSegment *seg = &state->segments[i];
+        if (seg->valid && jd >= seg->start && jd < seg->start + seg->span) {
+            seg->last_use = use_clock;
+            return seg;
+        }
+        if (!seg->valid || (victim->valid && seg->last_use < victim->last_use)) {
+            victim = seg;
+        }
+    }
+
+    while (1) {
+        double span = state->span;
+        JulianDay start = floor(jd / span) * span;
+        double err = fit_segment(victim, body, start, span);
+        if (err <= EPHEMERIS_TOLERANCE_DEG || state->halvings >= EPHEMERIS_MAX_HALVINGS) {
+            if (err > state->max_error) state->max_error = err;
+            break;
+        }
+        state->span *= 0.5;
+        state->halvings++;
+    }
+    victim->valid = 1;
+    victim->last_use = use_clock;
+    return victim;
+}
+
+// Called with ephemeris_lock held
+static void reset_states() {
+    memset(states, 0, sizeof(states));
+    memset(rst_cache, 0, sizeof(rst_cache));
+    for (int b = 0; b < EPHEMERIS_BODY_COUNT; b++) {
+        states[b].span = base_span[b];
+    }
+    states_ready = 1;
+}
+
+void ephemeris_get_equ(EphemerisBody body, JulianDay jd, double *ra, double *dec) {
+    if (body < 0 || body >= EPHEMERIS_BODY_COUNT || !isfinite(jd)) {
+        ephemeris_get_equ_exact(body, jd, ra, dec);
+        return;
+    }
+
+    double v[3];
+    pthread_mutex_lock(&ephemeris_lock);
+    if (!states_ready) reset_states();
+    segment_vector(find_segment(body, jd), jd, v);
+    pthread_mutex_unlock(&ephemeris_lock);
+
+    double r = atan2(v[1], v[0]) * (180.0 / M_PI);
+    if (r < 0) r += 360.0;
+    *ra = r;
+    *dec = atan2(v[2], sqrt(v[0] * v[0] + v[1] * v[1])) * (180.0 / M_PI);
+}
+
+double ephemeris_get_max_error(EphemerisBody body) {
+    if (body < 0 || body >= EPHEMERIS_BODY_COUNT) return 0.0;
+    pthread_mutex_lock(&ephemeris_lock);
+    double err = states_ready ? states[body].max_error : 0.0;
+    pthread_mutex_unlock(&ephemeris_lock);
+    return err;
+}
+
+void ephemeris_clear() {
+    pthread_mutex_lock(&ephemeris_lock);
+    reset_states();
+    pthread_mutex_unlock(&ephemeris_lock);
+}
+
+void ephemeris_libnova_lock() {
+    pthread_mutex_lock(&ephemeris_lock);
+}
+
+void ephemeris_libnova_unlock() {
+    pthread_mutex_unlock(&ephemeris_lock);
+}
+
+int ephemeris_get_rst(EphemerisBody body, Location loc, JulianDay jd_noon, double horizon, struct ln_rst_time *rst) {
+    if (body == EPHEMERIS_MOON) horizon = 0.0; // Not used; keeps the key canonical
+
+    pthread_mutex_lock(&ephemeris_lock);
+    if (!states_ready) reset_states();
+    use_clock++;
+
+    RstEntry *victim = &rst_cache[0];
+    for (int i = 0; i < RST_CACHE_SIZE; i++) {
+        RstEntry *e = &rst_cache[i];
+        if (e->valid && e->body == body && e->lat == loc.lat && e->lon == loc.lon && e->jd_noon == jd_noon && e->horizon == horizon) {
+            e->last_use = use_clock;
+            *rst = e->rst;
+            int status = e->status;
+            pthread_mutex_unlock(&ephemeris_lock);
+            return status;
+        }
+        if (!e->valid || (victim->valid && e->last_use < victim->last_use)) {
+            victim = e;
+        }
+    }
+
+    struct ln_lnlat_posn observer = {loc.lon, loc.lat};
+    struct ln_rst_time r;
+    int status;
+    if (body == EPHEMERIS_MOON) {
+        status = ln_get_lunar_rst(jd_noon, &observer, &r);
+    } else {
+        status = ln_get_solar_rst_horizon(jd_noon, &observer, horizon, &r);
+    }
+    if (status != 0) {
+        r.rise = r.set = r.transit = -1.0; // libnova leaves them unset
+    }
+
+    victim->valid = 1;
+    victim->body = body;
+    victim->lat = loc.lat;
+    victim->lon = loc.lon;
+    victim->jd_noon = jd_noon;
+    victim->horizon = horizon;
+    victim->status = status;
+    victim->rst = r;
+    victim->last_use = use_clock;
+    pthread_mutex_unlock(&ephemeris_lock);
+
+    *rst = r;
+    return status;
+}
@@ -0,0 +1,57 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include "sky_model.h"
+
+// Solar system bodies served by the ephemeris. The planets follow PlanetID order.
+typedef enum {
+    EPHEMERIS_SUN,
+    EPHEMERIS_MOON,
+    EPHEMERIS_MERCURY,
+    EPHEMERIS_VENUS,
+    EPHEMERIS_MARS,
+    EPHEMERIS_JUPITER,
+    EPHEMERIS_SATURN,
+    EPHEMERIS_URANUS,
+    EPHEMERIS_NEPTUNE,
+    EPHEMERIS_BODY_COUNT
+} EphemerisBody;
+
+#define EPHEMERIS_PLANET(p) ((EphemerisBody)(EPHEMERIS_MERCURY + (p)))
+
+// Each body's apparent geocentric direction is fitted with Chebyshev
+// polynomials over fixed, aligned time segments (a few days; shorter for the
+// Moon), evaluated from libnova at the Chebyshev nodes. A fit is checked
+// against libnova between the nodes and its segment is halved until the
+// error is under this bound (degrees).
+#define EPHEMERIS_TOLERANCE_DEG (0.5 / 3600.0)
+
+// RA/Dec (degrees) of a body at a UT Julian day from the fitted segments.
+// Thread safe; the first query in a segment pays for the fit.
+void ephemeris_get_equ(EphemerisBody body, JulianDay jd, double *ra, double *dec);
+
+// The same position from the full libnova series
+void ephemeris_get_equ_exact(EphemerisBody body, JulianDay jd, double *ra, double *dec);
+
+// Largest error (degrees) measured against libnova over the accepted fits so far
+double ephemeris_get_max_error(EphemerisBody body);
+
+// Rise, transit and set of the Sun or Moon for the local day around jd_noon,
+// as ln_get_solar_rst_horizon()/ln_get_lunar_rst() would give. Results are
+// memoized on (body, site, jd_noon, horizon), so redraws that keep the date
+// and site reuse them. The Moon uses libnova's lunar horizon and ignores
+// `horizon`. Returns 0 if the body rises and sets; otherwise (always above or
+// below the horizon) returns non-zero and every time in rst is -1.
+int ephemeris_get_rst(EphemerisBody body, Location loc, JulianDay jd_noon, double horizon, struct ln_rst_time *rst);
+
+// Drops all fitted segments and memoized rise/set times
+void ephemeris_clear();
+
+// libnova keeps unsynchronized caches (nutation among them), so its calls must
+// not overlap across threads. The functions above take care of it; code that
+// calls libnova directly and may run on several threads brackets the calls
+// with these.
+void ephemeris_libnova_lock();
+void ephemeris_libnova_unlock();
+
+#endif
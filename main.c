@@ -10,24 +10,7 @@
 #include "elevation_view.h"
 #include "source_selection.h"
 #include "target_list.h"
-
-// Site Definition
-typedef struct {
-    const char *name;
-    double lat;
-    double lon;
-    double elevation; // meters
-    double timezone_offset;
-} Site;
-
-Site sites[] = {
-    {"Maunakea Observatories", 19.8207, -155.4681, 4205.0, -10.0},
-    {"La Palma (Roque de los Muchachos)", 28.7636, -17.8947, 2396.0, 0.0},
-    {"Paranal Observatory", -24.6275, -70.4044, 2635.0, -4.0},
-    {"Las Campanas Observatory", -29.0146, -70.6926, 2380.0, -4.0},
-    {"New York City", 40.7128, -74.0060, 10.0, -5.0},
-    {NULL, 0, 0, 0, 0}
-};
+#include "site.h"
 
 // Global State
 Location loc = {19.8207, -155.4681, 4205.0};
@@ -800,9 +783,7 @@ static void on_site_changed(GObject *object, GParamSpec *pspec, gpointer user_da
     guint selected = gtk_drop_down_get_selected(dropdown);
 
     if (selected != GTK_INVALID_LIST_POSITION && sites[selected].name) {
-        loc.lat = sites[selected].lat;
-        loc.lon = sites[selected].lon;
-        loc.elevation = sites[selected].elevation;
+        loc = site_location(&sites[selected]);
         dt.timezone_offset = sites[selected].timezone_offset;
         update_all_views();
     }
@@ -836,49 +817,18 @@ static void on_day_selected(GtkCalendar *calendar, gpointer user_data) {
 static void on_time_adjust_clicked(GtkButton *btn, gpointer user_data) {
     int minutes = (int)(intptr_t)user_data;
 
-    // Simple rollover logic
-    struct tm t = {0};
-    t.tm_year = dt.year - 1900;
-    t.tm_mon = dt.month - 1;
-    t.tm_mday = dt.day;
-    t.tm_hour = dt.hour;
-    t.tm_min = dt.minute;
-    t.tm_sec = (int)dt.second;
-    t.tm_isdst = -1;
-
-    t.tm_min += minutes;
-    mktime(&t); // Normalize
-
-    dt.year = t.tm_year + 1900;
-    dt.month = t.tm_mon + 1;
-    dt.day = t.tm_mday;
-    dt.hour = t.tm_hour;
-    dt.minute = t.tm_min;
-    dt.second = t.tm_sec;
+    // Rolls over days/months in the site's zone, whatever the host's TZ/DST
+    dt = datetime_add_hours(dt, minutes / 60.0);
 
     update_date_label();
     update_all_views();
 }
 
 static void on_time_current_clicked(GtkButton *btn, gpointer user_data) {
+    // "Now" in the site's timezone. time(NULL) counts seconds since the
+    // Unix epoch, JD 2440587.5.
     time_t t = time(NULL);
-    // We want to set dt to "Now" in the Site's timezone.
-    // dt.timezone_offset is set.
-    // time(NULL) is UTC (epoch).
-
-    // Get UTC struct
-    struct tm *tm_utc = gmtime(&t);
-
-    // Add timezone offset (hours)
-    time_t t_local = t + (int)(dt.timezone_offset * 3600.0);
-    struct tm *tm_loc = gmtime(&t_local); // treat as UTC to get fields
-
-    dt.year = tm_loc->tm_year + 1900;
-    dt.month = tm_loc->tm_mon + 1;
-    dt.day = tm_loc->tm_mday;
-    dt.hour = tm_loc->tm_hour;
-    dt.minute = tm_loc->tm_min;
-    dt.second = tm_loc->tm_sec;
+    dt = datetime_from_julian_day(2440587.5 + (double)t / 86400.0, dt.timezone_offset);
 
     update_date_label();
     update_all_views();
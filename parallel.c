@@ -0,0 +1,168 @@
+#include "parallel.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define PARALLEL_MAX_THREADS 64
+
+static int requested_threads = 0; // 0 = one per CPU
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t call_lock = PTHREAD_MUTEX_INITIALIZER; // One loop at a time
+
+static pthread_t workers[PARALLEL_MAX_THREADS];
+static int num_workers = 0;
+static int pool_stop = 0;
+
+// Current job, protected by pool_lock
+static ParallelChunkFunc job_fn = NULL;
+static void *job_ctx = NULL;
+static int job_count = 0;
+static int job_chunk = 0;
+static int job_next = 0; // Start of the next unclaimed chunk
+static int job_pending = 0; // Chunks not yet finished
+static unsigned long job_generation = 0;
+
+static pthread_key_t worker_key; // Set while a thread is running chunks
+static pthread_once_t worker_key_once = PTHREAD_ONCE_INIT;
+
+static void make_worker_key() {
+    pthread_key_create(&worker_key, NULL);
+}
+
+// Claims and runs chunks of the current job until none are left. Called with pool_lock held.
+static void run_chunks() {
+    while (job_next < job_count) {
+        int begin = job_next;
+        int end = begin + job_chunk;
+        if (end > job_count) end = job_count;
+        job_next = end;
+
+        pthread_mutex_unlock(&pool_lock);
+        job_fn(begin, end, job_ctx);
+        pthread_mutex_lock(&pool_lock);
+
+        if (--job_pending == 0) {
+            pthread_cond_broadcast(&done_cond);
+        }
+    }
+}
+
+static void *worker_main(void *arg) {
+    (void)arg;
+    pthread_setspecific(worker_key, (void *)1);
+
+    pthread_mutex_lock(&pool_lock);
+    unsigned long seen = job_generation;
+    while (1) {
+        while (!pool_stop && job_generation == seen) {
+            pthread_cond_wait(&work_cond, &pool_lock);
+        }
+        if (pool_stop) break;
+        seen = job_generation;
+        run_chunks();
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+int parallel_get_threads() {
+    int n = requested_threads;
+    if (n <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n = (cpus > 0) ? (int)cpus : 1;
+    }
+    if (n > PARALLEL_MAX_THREADS) n = PARALLEL_MAX_THREADS;
+    return n;
+}
+
+// Stops and joins all workers. Called with call_lock held.
+static void stop_workers() {
+    pthread_mutex_lock(&pool_lock);
+    pool_stop = 1;
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    num_workers = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    pool_stop = 0;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+// Starts workers until there are `wanted` of them. Called with call_lock held.
+static void ensure_workers(int wanted) {
+    while (num_workers < wanted) {
+        if (pthread_create(&workers[num_workers], NULL, worker_main, NULL) != 0) {
+            fprintf(stderr, "Warning: could not start worker thread; continuing with %d.\n", num_workers);
+            break;
+        }
+        num_workers++;
+    }
+}
+
+void parallel_set_threads(int threads) {
+    pthread_mutex_lock(&call_lock);
+    requested_threads = threads;
+    // Surplus workers would keep claiming chunks; restart the pool on demand
+    if (num_workers > parallel_get_threads() - 1) {
+        stop_workers();
+    }
+    pthread_mutex_unlock(&call_lock);
+}
+
+void parallel_shutdown() {
+    pthread_mutex_lock(&call_lock);
+    stop_workers();
+    pthread_mutex_unlock(&call_lock);
+}
+
+void parallel_for(int count, int min_chunk, ParallelChunkFunc fn, void *ctx) {
+    if (count <= 0) return;
+    if (min_chunk < 1) min_chunk = 1;
+
+    pthread_once(&worker_key_once, make_worker_key);
+    int threads = parallel_get_threads();
+    if (threads <= 1 || count <= min_chunk || pthread_getspecific(worker_key)) {
+        fn(0, count, ctx);
+        return;
+    }
+
+    pthread_mutex_lock(&call_lock);
+
+    // A few chunks per thread so uneven chunks balance out
+    int chunk = count / (threads * 4);
+    if (chunk < min_chunk) chunk = min_chunk;
+
+    ensure_workers(threads - 1);
+
+    pthread_mutex_lock(&pool_lock);
+    job_fn = fn;
+    job_ctx = ctx;
+    job_count = count;
+    job_chunk = chunk;
+    job_next = 0;
+    job_pending = (count + chunk - 1) / chunk;
+    job_generation++;
+    pthread_cond_broadcast(&work_cond);
+
+    // The caller works too, then waits for chunks still running elsewhere.
+    // While it does, nested parallel_for calls from fn run serially.
+    pthread_setspecific(worker_key, (void *)1);
+    run_chunks();
+    pthread_setspecific(worker_key, NULL);
+    while (job_pending > 0) {
+        pthread_cond_wait(&done_cond, &pool_lock);
+    }
+    job_fn = NULL;
+    job_ctx = NULL;
+    pthread_mutex_unlock(&pool_lock);
+
+    pthread_mutex_unlock(&call_lock);
+}
@@ -0,0 +1,22 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Minimal pthread worker pool for data-parallel loops.
+// fn(begin, end, ctx) is called on disjoint chunks covering [0, count). Chunks
+// run concurrently, so fn may only write to its own slice of any output.
+typedef void (*ParallelChunkFunc)(int begin, int end, void *ctx);
+
+// Runs fn over [0, count) in chunks of at least min_chunk items and returns when
+// every chunk has finished. Small counts, a single-thread setting, or calls made
+// from inside a worker run serially on the calling thread.
+void parallel_for(int count, int min_chunk, ParallelChunkFunc fn, void *ctx);
+
+// Number of threads used by parallel_for, including the caller. 0 (the default)
+// means one per online CPU. Must not be changed while a loop is running.
+void parallel_set_threads(int threads);
+int parallel_get_threads();
+
+// Stops the workers (they are restarted on demand)
+void parallel_shutdown();
+
+#endif
@@ -0,0 +1,30 @@
+#include "site.h"
+#include <string.h>
+#include <strings.h>
+
+const Site sites[] = {
+    {"Maunakea Observatories", 19.8207, -155.4681, 4205.0, -10.0},
+    {"La Palma (Roque de los Muchachos)", 28.7636, -17.8947, 2396.0, 0.0},
+    {"Paranal Observatory", -24.6275, -70.4044, 2635.0, -4.0},
+    {"Las Campanas Observatory", -29.0146, -70.6926, 2380.0, -4.0},
+    {"New York City", 40.7128, -74.0060, 10.0, -5.0},
+    {NULL, 0, 0, 0, 0}
+};
+
+const Site *site_find(const char *name) {
+    if (!name) return NULL;
+    for (int i = 0; sites[i].name != NULL; i++) {
+        if (strcasecmp(sites[i].name, name) == 0) return &sites[i];
+    }
+    size_t len = strlen(name);
+    if (len == 0) return NULL;
+    for (int i = 0; sites[i].name != NULL; i++) {
+        if (strncasecmp(sites[i].name, name, len) == 0) return &sites[i];
+    }
+    return NULL;
+}
+
+Location site_location(const Site *site) {
+    Location loc = {site->lat, site->lon, site->elevation};
+    return loc;
+}
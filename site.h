@@ -0,0 +1,24 @@
+#ifndef SITE_H
+#define SITE_H
+
+#include "sky_model.h"
+
+// Site Definition
+typedef struct {
+    const char *name;
+    double lat;
+    double lon;
+    double elevation; // meters
+    double timezone_offset;
+} Site;
+
+// Built-in observatory sites, terminated by an entry with a NULL name
+extern const Site sites[];
+
+// Site whose name matches (case-insensitively) in full, else the first one it
+// is a prefix of; NULL if none
+const Site *site_find(const char *name);
+
+Location site_location(const Site *site);
+
+#endif
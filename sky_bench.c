@@ -0,0 +1,345 @@
+// sky_bench: timings of the hot paths (catalog load, coordinate transforms,
+// cone search, elevation curves, ephemeris and full sky frames rendered
+// offscreen) for a fixed site and time, written as JSON so runs can be
+// compared across builds, libnova versions and options. The ephemeris fits'
+// measured error against libnova is reported alongside.
+#include "catalog.h"
+#include "ephemeris.h"
+#include "parallel.h"
+#include "site.h"
+#include "sky_model.h"
+#include "sky_render.h"
+#include "star_index.h"
+#include <cairo.h>
+#include <getopt.h>
+#include <jansson.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_CURVE_SAMPLES 97 // As the elevation graph: every 10 minutes over 16 hours
+#define BENCH_CONE_QUERIES 100
+#define BENCH_EPHEMERIS_QUERIES 1000
+
+typedef void (*BenchFunc)(void *ctx);
+
+static const char *const ephemeris_body_names[EPHEMERIS_BODY_COUNT] = {
+    "sun", "moon", "mercury", "venus", "mars", "jupiter", "saturn", "uranus", "neptune"
+};
+
+static double min_time = 0.25; // Seconds of repetitions per benchmark
+static const char *filter = NULL;
+static json_t *results = NULL;
+
+// Fixed scene so that runs are comparable
+static Location bench_loc;
+static DateTime bench_dt = {2024, 10, 5, 22, 0, 0, -10.0};
+static SkyViewOptions bench_options = {
+    .show_constellation_lines = 1,
+    .show_constellation_names = 1,
+    .show_alt_az_grid = 1,
+    .show_ra_dec_grid = 1,
+    .show_planets = 1,
+    .show_moon_circles = 0,
+    .show_ecliptic = 1,
+    .star_mag_limit = 8.0,
+    .star_size_m0 = 7.0,
+    .star_size_ma = 0.4,
+    .show_star_colors = 1,
+    .star_saturation = 1.0,
+    .auto_star_settings = 1,
+    .font_scale = 1.0,
+    .ephemeris_use_ut = 0
+};
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Runs fn until min_time has passed (at least 3 times, after one warm-up run)
+// and records the mean and best time per run. items is the work done per run.
+static void run_bench(const char *name, BenchFunc fn, void *ctx, long items) {
+    if (filter && !strstr(name, filter)) return;
+
+    fn(ctx);
+    int iterations = 0;
+    double total = 0.0, best = HUGE_VAL;
+    while (iterations < 3 || total < min_time) {
+        double t0 = now_seconds();
+        fn(ctx);
+        double dt = now_seconds() - t0;
+        total += dt;
+        if (dt < best) best = dt;
+        iterations++;
+    }
+
+    double mean = total / iterations;
+    json_t *r = json_object();
+    json_object_set_new(r, "name", json_string(name));
+    json_object_set_new(r, "iterations", json_integer(iterations));
+    json_object_set_new(r, "mean_ms", json_real(mean * 1e3));
+    json_object_set_new(r, "min_ms", json_real(best * 1e3));
+    json_object_set_new(r, "items", json_integer(items));
+    json_object_set_new(r, "items_per_second", json_real(items / best));
+    json_array_append_new(results, r);
+    fprintf(stderr, "%-32s %10.3f ms (min %.3f, %d runs)\n", name, mean * 1e3, best * 1e3, iterations);
+}
+
+static void bench_catalog_load(void *ctx) {
+    (void)ctx;
+    free_catalog();
+    if (load_catalog() != 0) {
+        fprintf(stderr, "Failed to load catalog.\n");
+        exit(1);
+    }
+}
+
+// Scratch for the all-star transform
+typedef struct {
+    ObserverFrame frame;
+    int count;
+    double *alt, *az;
+} TransformBench;
+
+static void bench_transform_vectors(void *data) {
+    TransformBench *b = data;
+    observer_frame_get_horizontal_vectors(&b->frame, star_catalog.x, star_catalog.y, star_catalog.z, NULL, b->count, b->alt, b->az);
+}
+
+static void bench_transform_radec(void *data) {
+    TransformBench *b = data;
+    observer_frame_get_horizontal_batch(&b->frame, star_catalog.ra, star_catalog.dec, b->count, b->alt, b->az);
+}
+
+// One-shot entry point: the frame solve is part of every run
+static void bench_transform_batch(void *data) {
+    TransformBench *b = data;
+    get_horizontal_coordinates_batch(star_catalog.ra, star_catalog.dec, b->count, bench_loc, bench_dt, b->alt, b->az);
+}
+
+static void bench_cone_search(void *ctx) {
+    (void)ctx;
+    for (int q = 0; q < BENCH_CONE_QUERIES; q++) {
+        // Centres spread over the sphere; the same every run
+        double ra = fmod(q * 137.508, 360.0);
+        double dec = asin(2.0 * (q + 0.5) / BENCH_CONE_QUERIES - 1.0) * (180.0 / M_PI);
+        int count = 0;
+        int *found = catalog_cone_search(ra, dec, 5.0, 9.0, &count);
+        free(found);
+    }
+}
+
+// Altitude curves for a night, sampled as the elevation graph does
+typedef struct {
+    int count;
+    double *ra, *dec;
+    double *alt; // count * BENCH_CURVE_SAMPLES
+} CurveBench;
+
+static void bench_elevation_curves(void *data) {
+    CurveBench *b = data;
+    ObserverFrame frames[BENCH_CURVE_SAMPLES];
+    JulianDay start = get_julian_day(bench_dt) - 8.0 / HOURS_PER_DAY;
+    observer_frame_init_jd(&frames[0], bench_loc, start);
+    for (int k = 1; k < BENCH_CURVE_SAMPLES; k++) {
+        frames[k] = frames[k - 1];
+        observer_frame_advance_jd(&frames[k], bench_loc, start + k / 6.0 / HOURS_PER_DAY);
+    }
+    for (int i = 0; i < b->count; i++) {
+        double *alt = &b->alt[(size_t)i * BENCH_CURVE_SAMPLES];
+        for (int k = 0; k < BENCH_CURVE_SAMPLES; k++) {
+            double az;
+            observer_frame_get_horizontal(&frames[k], b->ra[i], b->dec[i], &alt[k], &az);
+        }
+    }
+}
+
+// Cold start: every body fitted afresh
+static void bench_ephemeris_fit(void *ctx) {
+    (void)ctx;
+    ephemeris_clear();
+    JulianDay jd = get_julian_day(bench_dt);
+    for (int b = 0; b < EPHEMERIS_BODY_COUNT; b++) {
+        double ra, dec;
+        ephemeris_get_equ((EphemerisBody)b, jd, &ra, &dec);
+    }
+}
+
+static void bench_ephemeris_fitted(void *ctx) {
+    (void)ctx;
+    JulianDay jd = get_julian_day(bench_dt);
+    for (int q = 0; q < BENCH_EPHEMERIS_QUERIES; q++) {
+        double ra, dec;
+        ephemeris_get_equ((EphemerisBody)(q % EPHEMERIS_BODY_COUNT), jd + q * 0.0005, &ra, &dec);
+    }
+}
+
+static void bench_ephemeris_exact(void *ctx) {
+    (void)ctx;
+    JulianDay jd = get_julian_day(bench_dt);
+    for (int q = 0; q < BENCH_EPHEMERIS_QUERIES; q++) {
+        double ra, dec;
+        ephemeris_get_equ_exact((EphemerisBody)(q % EPHEMERIS_BODY_COUNT), jd + q * 0.0005, &ra, &dec);
+    }
+}
+
+// One full sky frame into an offscreen image surface
+typedef struct {
+    int size;
+    int time_step; // Advance the clock a minute per frame, as when scrubbing
+    SkyScene scene;
+    SkyRenderer *renderer;
+    cairo_surface_t *surface;
+} FrameBench;
+
+static void bench_sky_frame(void *data) {
+    FrameBench *b = data;
+    if (b->time_step) b->scene.dt = datetime_add_hours(b->scene.dt, 1.0 / 60.0);
+    sky_renderer_invalidate(b->renderer); // The layer is rebuilt every run
+    cairo_t *cr = cairo_create(b->surface);
+    sky_renderer_draw(b->renderer, cr, b->size, b->size, 1, &b->scene);
+    cairo_destroy(cr);
+}
+
+static void run_frame_bench(int size, double zoom, int time_step) {
+    char name[64];
+    snprintf(name, sizeof(name), "sky_frame%s_%d_zoom%g", time_step ? "_time_step" : "", size, zoom);
+    if (filter && !strstr(name, filter)) return;
+
+    FrameBench b;
+    b.size = size;
+    b.time_step = time_step;
+    sky_scene_init(&b.scene, bench_loc, bench_dt, &bench_options);
+    b.scene.view.zoom = zoom;
+    b.renderer = sky_renderer_new();
+    if (!b.renderer) return;
+    b.surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, size, size);
+    run_bench(name, bench_sky_frame, &b, 1);
+    cairo_surface_destroy(b.surface);
+    sky_renderer_free(b.renderer);
+}
+
+static void usage(FILE *out) {
+    fprintf(out,
+        "Usage: sky_bench [options]\n"
+        "  --min-time S     Seconds of repetitions per benchmark (default 0.25)\n"
+        "  --targets N      Targets for the elevation curve benchmark (default 1000)\n"
+        "  --filter TEXT    Only run benchmarks whose name contains TEXT\n"
+        "  --threads N      Worker threads (default: one per CPU)\n"
+        "  --output FILE    Write the JSON results to FILE instead of standard output\n"
+        "Run from the directory holding the catalog files.\n");
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"min-time", required_argument, NULL, 't'},
+        {"targets", required_argument, NULL, 'n'},
+        {"filter", required_argument, NULL, 'f'},
+        {"threads", required_argument, NULL, 'j'},
+        {"output", required_argument, NULL, 'o'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int num_targets = 1000;
+    const char *output = NULL;
+    int c;
+    while ((c = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+        switch (c) {
+            case 't': min_time = atof(optarg); break;
+            case 'n': num_targets = atoi(optarg); break;
+            case 'f': filter = optarg; break;
+            case 'j': parallel_set_threads(atoi(optarg)); break;
+            case 'o': output = optarg; break;
+            case 'h': usage(stdout); return 0;
+            default: usage(stderr); return 1;
+        }
+    }
+    if (num_targets < 1) num_targets = 1;
+
+    bench_loc = site_location(&sites[0]);
+    results = json_array();
+
+    // Everything after it needs the catalog, even when catalog_load is filtered out
+    bench_catalog_load(NULL);
+    run_bench("catalog_load", bench_catalog_load, NULL, num_stars);
+
+    TransformBench tb;
+    observer_frame_init(&tb.frame, bench_loc, bench_dt);
+    tb.count = num_stars;
+    tb.alt = malloc(sizeof(double) * num_stars);
+    tb.az = malloc(sizeof(double) * num_stars);
+    run_bench("transform_vectors_all_stars", bench_transform_vectors, &tb, num_stars);
+    run_bench("transform_radec_all_stars", bench_transform_radec, &tb, num_stars);
+    run_bench("transform_batch_all_stars", bench_transform_batch, &tb, num_stars);
+    free(tb.alt);
+    free(tb.az);
+
+    run_bench("cone_search_5deg", bench_cone_search, NULL, BENCH_CONE_QUERIES);
+
+    CurveBench cb;
+    cb.count = num_targets;
+    cb.ra = malloc(sizeof(double) * num_targets);
+    cb.dec = malloc(sizeof(double) * num_targets);
+    cb.alt = malloc(sizeof(double) * num_targets * BENCH_CURVE_SAMPLES);
+    for (int i = 0; i < num_targets; i++) {
+        cb.ra[i] = fmod(i * 137.508, 360.0);
+        cb.dec[i] = asin(2.0 * (i + 0.5) / num_targets - 1.0) * (180.0 / M_PI);
+    }
+    run_bench("elevation_curves", bench_elevation_curves, &cb, (long)num_targets * BENCH_CURVE_SAMPLES);
+    free(cb.ra);
+    free(cb.dec);
+    free(cb.alt);
+
+    run_bench("ephemeris_fit", bench_ephemeris_fit, NULL, EPHEMERIS_BODY_COUNT);
+    run_bench("ephemeris_fitted", bench_ephemeris_fitted, NULL, BENCH_EPHEMERIS_QUERIES);
+    run_bench("ephemeris_exact", bench_ephemeris_exact, NULL, BENCH_EPHEMERIS_QUERIES);
+
+    // Error bound of the fits the runs above made, against libnova
+    json_t *ephemeris_error = json_object();
+    for (int b = 0; b < EPHEMERIS_BODY_COUNT; b++) {
+        double err = ephemeris_get_max_error((EphemerisBody)b) * 3600.0;
+        json_object_set_new(ephemeris_error, ephemeris_body_names[b], json_real(err));
+        if (err > EPHEMERIS_TOLERANCE_DEG * 3600.0) {
+            fprintf(stderr, "Warning: %s ephemeris fit is off by %.3f arcsec, over the %.3f arcsec tolerance\n",
+                    ephemeris_body_names[b], err, EPHEMERIS_TOLERANCE_DEG * 3600.0);
+        }
+    }
+
+    const int sizes[] = {512, 1024, 2048};
+    const double zooms[] = {1.0, 4.0};
+    for (int s = 0; s < 3; s++) {
+        for (int z = 0; z < 2; z++) {
+            run_frame_bench(sizes[s], zooms[z], 0);
+        }
+    }
+    run_frame_bench(1024, 1.0, 1);
+
+    json_t *root = json_object();
+    json_object_set_new(root, "site", json_string(sites[0].name));
+    json_object_set_new(root, "stars", json_integer(num_stars));
+    json_object_set_new(root, "threads", json_integer(parallel_get_threads()));
+    json_object_set_new(root, "min_time", json_real(min_time));
+    json_object_set_new(root, "benchmarks", results);
+    json_object_set_new(root, "ephemeris_max_error_arcsec", ephemeris_error);
+
+    int ret = 0;
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        perror(output);
+        ret = 1;
+    } else {
+        if (json_dumpf(root, out, JSON_INDENT(2)) != 0) ret = 1;
+        fputc('\n', out);
+        if (out != stdout && fclose(out) != 0) ret = 1;
+    }
+    json_decref(root);
+
+    free_catalog();
+    parallel_shutdown();
+    return ret;
+}
@@ -0,0 +1,387 @@
+// sky_chart: writes the sky view for a site and time as a PNG, SVG or PDF
+// chart, drawn by the same renderer as the application window, or a numbered
+// PNG sequence over a time range for time-lapses. Needs no display; GTK is
+// never initialised.
+#include "catalog.h"
+#include "ephemeris.h"
+#include "parallel.h"
+#include "site.h"
+#include "sky_model.h"
+#include "sky_render.h"
+#include "target_list.h"
+#include <getopt.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MAX_FRAMES 100000
+
+// Overlays that --show/--hide switch, by name
+typedef struct {
+    const char *name;
+    size_t offset; // Of the int flag in SkyViewOptions
+} OverlayName;
+
+static const OverlayName overlay_names[] = {
+    {"constellations", offsetof(SkyViewOptions, show_constellation_lines)},
+    {"names", offsetof(SkyViewOptions, show_constellation_names)},
+    {"altaz-grid", offsetof(SkyViewOptions, show_alt_az_grid)},
+    {"radec-grid", offsetof(SkyViewOptions, show_ra_dec_grid)},
+    {"planets", offsetof(SkyViewOptions, show_planets)},
+    {"moon-circles", offsetof(SkyViewOptions, show_moon_circles)},
+    {"ecliptic", offsetof(SkyViewOptions, show_ecliptic)},
+    {"colors", offsetof(SkyViewOptions, show_star_colors)},
+    {NULL, 0}
+};
+
+// Sets the named overlays (comma separated) to value. Returns -1 for an unknown name.
+static int set_overlays(SkyViewOptions *options, const char *list, int value) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (char *name = strtok(buf, ","); name; name = strtok(NULL, ",")) {
+        int found = 0;
+        for (int i = 0; overlay_names[i].name; i++) {
+            if (strcasecmp(name, overlay_names[i].name) == 0) {
+                *(int *)((char *)options + overlay_names[i].offset) = value;
+                found = 1;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Unknown overlay '%s'.\n", name);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Frame names come from a user-supplied printf format: accept only those
+// with exactly one %d (flags and width allowed) besides literal %%
+static int valid_frame_pattern(const char *pattern) {
+    int conversions = 0;
+    for (const char *p = pattern; *p; p++) {
+        if (*p != '%') continue;
+        p++;
+        if (*p == '%') continue;
+        while (*p == '0' || *p == '-' || *p == '+' || *p == ' ') p++;
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p != 'd') return 0;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+// Sunset on the date to the next sunrise, as the sky view's night is bounded.
+// Returns -1 if the Sun does not set or rise.
+static int night_range(Location loc, DateTime date, JulianDay *start, JulianDay *end) {
+    DateTime noon_dt = date;
+    noon_dt.hour = 12; noon_dt.minute = 0; noon_dt.second = 0;
+    JulianDay jd_noon = get_julian_day(noon_dt);
+    double horizon = -0.833; // Approx geometrical horizon
+
+    struct ln_rst_time rst;
+    if (ephemeris_get_rst(EPHEMERIS_SUN, loc, jd_noon, horizon, &rst) != 0) return -1;
+    *start = rst.set;
+    *end = rst.rise;
+    if (*end < *start) {
+        if (ephemeris_get_rst(EPHEMERIS_SUN, loc, jd_noon + 1.0, horizon, &rst) != 0) return -1;
+        *end = rst.rise;
+    }
+    return (*end > *start) ? 0 : -1;
+}
+
+static void usage(FILE *out) {
+    fprintf(out,
+        "Usage: sky_chart --date YYYY-MM-DD --time HH:MM (--site NAME | --lat DEG --lon DEG) --output FILE [options]\n"
+        "       sky_chart --date YYYY-MM-DD (--night | --time HH:MM --until HH:MM) ... --output PATTERN\n"
+        "  --site NAME        Built-in site (see --list-sites); a name prefix is enough\n"
+        "  --lat DEG, --lon DEG, --elevation M, --timezone HOURS\n"
+        "                     Custom site (east longitude and zone positive)\n"
+        "  --date YYYY-MM-DD  Local date\n"
+        "  --time HH:MM[:SS]  Local time\n"
+        "  --night            PNG frames from sunset on the date to the next sunrise\n"
+        "  --until HH:MM[:SS] PNG frames from --time to this local time (the next day if earlier)\n"
+        "  --step MIN         Minutes between frames (default 5)\n"
+        "  --output FILE      Chart file; the format follows the extension. For frames, a\n"
+        "                     name with one %%d for the frame number, e.g. night_%%04d.png\n"
+        "  --format FMT       png, svg or pdf, whatever the extension\n"
+        "  --size N           Width and height in pixels or points (default 1024)\n"
+        "  --width N, --height N\n"
+        "  --zoom X           Zoom factor (default 1)\n"
+        "  --rotation DEG     Rotation of the view\n"
+        "  --horizon AZ       Horizon projection facing AZ (0 = South, 180 = North)\n"
+        "  --mag-limit MAG    Faintest star drawn (default: set from the zoom)\n"
+        "  --show LIST        Overlays to draw, comma separated: constellations, names,\n"
+        "                     altaz-grid, radec-grid, planets, moon-circles, ecliptic, colors\n"
+        "  --hide LIST        Overlays to leave out\n"
+        "  --targets FILE     Target list saved by the application, drawn as markers\n"
+        "  --highlight NAME   Target of that list whose path over the night is drawn\n"
+        "  --ut               Ephemeris times in UT instead of local time\n"
+        "  --font-scale X     Text size factor (default 1)\n"
+        "  --threads N        Worker threads (default: one per CPU)\n"
+        "  --list-sites       Print the built-in sites and exit\n"
+        "Run from the directory holding the catalog files.\n");
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"site", required_argument, NULL, 's'},
+        {"lat", required_argument, NULL, 'a'},
+        {"lon", required_argument, NULL, 'o'},
+        {"elevation", required_argument, NULL, 'e'},
+        {"timezone", required_argument, NULL, 'z'},
+        {"date", required_argument, NULL, 'd'},
+        {"time", required_argument, NULL, 't'},
+        {"night", no_argument, NULL, 'N'},
+        {"until", required_argument, NULL, 'U'},
+        {"step", required_argument, NULL, 'P'},
+        {"output", required_argument, NULL, 'O'},
+        {"format", required_argument, NULL, 'f'},
+        {"size", required_argument, NULL, 'S'},
+        {"width", required_argument, NULL, 'W'},
+        {"height", required_argument, NULL, 'H'},
+        {"zoom", required_argument, NULL, 'Z'},
+        {"rotation", required_argument, NULL, 'R'},
+        {"horizon", required_argument, NULL, 'A'},
+        {"mag-limit", required_argument, NULL, 'm'},
+        {"show", required_argument, NULL, 'v'},
+        {"hide", required_argument, NULL, 'x'},
+        {"targets", required_argument, NULL, 'T'},
+        {"highlight", required_argument, NULL, 'g'},
+        {"ut", no_argument, NULL, 'u'},
+        {"font-scale", required_argument, NULL, 'F'},
+        {"threads", required_argument, NULL, 'j'},
+        {"list-sites", no_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    // Same defaults as the application window
+    SkyViewOptions sky_options = {
+        .show_constellation_lines = 1,
+        .star_mag_limit = 8.0,
+        .star_size_m0 = 7.0,
+        .star_size_ma = 0.4,
+        .star_saturation = 1.0,
+        .auto_star_settings = 1,
+        .font_scale = 1.0
+    };
+
+    const Site *site = NULL;
+    Location loc = {0, 0, 0};
+    int have_lat = 0, have_lon = 0;
+    double tz = 0.0;
+    int have_tz = 0;
+    const char *date = NULL;
+    const char *time_text = NULL;
+    int night = 0;
+    const char *until = NULL;
+    double step_minutes = 5.0;
+    const char *output = NULL;
+    const char *format_name = NULL;
+    int width = 1024, height = 1024;
+    double zoom = 1.0;
+    double rotation = 0.0;
+    double horizon_az = NAN;
+    const char *targets_file = NULL;
+    const char *highlight = NULL;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+        switch (c) {
+            case 's':
+                site = site_find(optarg);
+                if (!site) {
+                    fprintf(stderr, "Unknown site '%s' (see --list-sites).\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'a': loc.lat = atof(optarg); have_lat = 1; break;
+            case 'o': loc.lon = atof(optarg); have_lon = 1; break;
+            case 'e': loc.elevation = atof(optarg); break;
+            case 'z': tz = atof(optarg); have_tz = 1; break;
+            case 'd': date = optarg; break;
+            case 't': time_text = optarg; break;
+            case 'N': night = 1; break;
+            case 'U': until = optarg; break;
+            case 'P': step_minutes = atof(optarg); break;
+            case 'O': output = optarg; break;
+            case 'f': format_name = optarg; break;
+            case 'S': width = height = atoi(optarg); break;
+            case 'W': width = atoi(optarg); break;
+            case 'H': height = atoi(optarg); break;
+            case 'Z': zoom = atof(optarg); break;
+            case 'R': rotation = atof(optarg); break;
+            case 'A': horizon_az = atof(optarg); break;
+            case 'm':
+                sky_options.star_mag_limit = atof(optarg);
+                sky_options.auto_star_settings = 0;
+                break;
+            case 'v': if (set_overlays(&sky_options, optarg, 1) != 0) return 1; break;
+            case 'x': if (set_overlays(&sky_options, optarg, 0) != 0) return 1; break;
+            case 'T': targets_file = optarg; break;
+            case 'g': highlight = optarg; break;
+            case 'u': sky_options.ephemeris_use_ut = 1; break;
+            case 'F': sky_options.font_scale = atof(optarg); break;
+            case 'j': parallel_set_threads(atoi(optarg)); break;
+            case 'l':
+                for (int i = 0; sites[i].name != NULL; i++) {
+                    printf("%s\t%.4f\t%.4f\t%.0f\t%+.1f\n", sites[i].name, sites[i].lat, sites[i].lon, sites[i].elevation, sites[i].timezone_offset);
+                }
+                return 0;
+            case 'h':
+                usage(stdout);
+                return 0;
+            default:
+                usage(stderr);
+                return 1;
+        }
+    }
+
+    if (site) {
+        loc = site_location(site);
+        if (!have_tz) tz = site->timezone_offset;
+    } else if (!have_lat || !have_lon) {
+        fprintf(stderr, "A site is required: --site or --lat and --lon.\n");
+        usage(stderr);
+        return 1;
+    }
+
+    DateTime dt = {0};
+    if (!date || sscanf(date, "%d-%d-%d", &dt.year, &dt.month, &dt.day) != 3) {
+        fprintf(stderr, "A date is required: --date YYYY-MM-DD.\n");
+        return 1;
+    }
+    if (night && until) {
+        fprintf(stderr, "--night and --until cannot be combined.\n");
+        return 1;
+    }
+    if (!night && (!time_text || sscanf(time_text, "%d:%d:%lf", &dt.hour, &dt.minute, &dt.second) < 2)) {
+        fprintf(stderr, "A time is required: --time HH:MM.\n");
+        return 1;
+    }
+    dt.timezone_offset = tz;
+
+    // Time-lapse: frames every step from jd_start through jd_end
+    int sequence = night || until;
+    JulianDay jd_start = get_julian_day(dt), jd_end = jd_start;
+    if (night) {
+        if (night_range(loc, dt, &jd_start, &jd_end) != 0) {
+            fprintf(stderr, "The Sun does not both set and rise on that night.\n");
+            return 1;
+        }
+        dt = datetime_from_julian_day(jd_start, tz);
+    } else if (until) {
+        DateTime end_dt = dt;
+        end_dt.second = 0;
+        if (sscanf(until, "%d:%d:%lf", &end_dt.hour, &end_dt.minute, &end_dt.second) < 2) {
+            fprintf(stderr, "Invalid --until time '%s' (HH:MM).\n", until);
+            return 1;
+        }
+        jd_end = get_julian_day(end_dt);
+        if (jd_end <= jd_start) jd_end += 1.0;
+    }
+
+    if (!output) {
+        fprintf(stderr, "An output file is required: --output FILE.\n");
+        return 1;
+    }
+    SkyChartFormat format;
+    if (sky_chart_format_parse(format_name ? format_name : output, &format) != 0) {
+        fprintf(stderr, "Unknown chart format for '%s' (png, svg or pdf).\n", format_name ? format_name : output);
+        return 1;
+    }
+    if (width < 32 || height < 32) {
+        fprintf(stderr, "The chart must be at least 32 x 32.\n");
+        return 1;
+    }
+    if (!(zoom > 0)) {
+        fprintf(stderr, "The zoom must be positive.\n");
+        return 1;
+    }
+    int frame_count = 1;
+    double step = step_minutes / 60.0 / HOURS_PER_DAY; // Days
+    if (sequence) {
+        if (format != SKY_CHART_PNG) {
+            fprintf(stderr, "Time-lapse frames are written as PNG only.\n");
+            return 1;
+        }
+        if (!valid_frame_pattern(output)) {
+            fprintf(stderr, "The output for frames needs exactly one %%d for the frame number, e.g. night_%%04d.png.\n");
+            return 1;
+        }
+        if (!(step_minutes > 0)) {
+            fprintf(stderr, "The step must be positive.\n");
+            return 1;
+        }
+        double frames = floor((jd_end - jd_start) / step + 1e-6) + 1;
+        if (frames > MAX_FRAMES) {
+            fprintf(stderr, "%.0f frames is too many (at most %d); use a longer --step.\n", frames, MAX_FRAMES);
+            return 1;
+        }
+        frame_count = (int)frames;
+    }
+
+    target_list_init();
+    const Target *highlighted = NULL;
+    if (targets_file) {
+        TargetList *list = target_list_load(targets_file);
+        if (!list) {
+            fprintf(stderr, "Failed to load target list %s.\n", targets_file);
+            target_list_cleanup();
+            return 1;
+        }
+        for (int i = 0; highlight && i < target_list_get_count(list); i++) {
+            const Target *tgt = target_list_get_target(list, i);
+            if (strcasecmp(tgt->name, highlight) == 0) highlighted = tgt;
+        }
+    }
+    if (highlight && !highlighted) {
+        fprintf(stderr, "Target '%s' is not in the target list.\n", highlight);
+        target_list_cleanup();
+        return 1;
+    }
+
+    if (load_catalog() != 0) {
+        fprintf(stderr, "Failed to load catalog.\n");
+        target_list_cleanup();
+        return 1;
+    }
+
+    SkyScene scene;
+    sky_scene_init(&scene, loc, dt, &sky_options);
+    if (!isnan(horizon_az)) {
+        sky_view_state_init(&scene.view, 1);
+        scene.view.horizon_center_az = fmod(fmod(horizon_az, 360.0) + 360.0, 360.0);
+    }
+    scene.view.zoom = zoom;
+    scene.view.pan_y *= zoom; // Keeps the horizon where the unzoomed view has it, as scrolling does
+    scene.view.rotation = rotation * M_PI / 180.0;
+    scene.highlighted = highlighted;
+
+    int ret = 1;
+    if (sequence) {
+        int failed = sky_render_timelapse(&scene, jd_start, step, frame_count, width, height, output);
+        DateTime first = datetime_from_julian_day(jd_start, tz);
+        DateTime last = datetime_from_julian_day(jd_start + (frame_count - 1) * step, tz);
+        fprintf(stderr, "%d frames from %04d-%02d-%02d %02d:%02d to %04d-%02d-%02d %02d:%02d every %g min",
+                frame_count, first.year, first.month, first.day, first.hour, first.minute,
+                last.year, last.month, last.day, last.hour, last.minute, step_minutes);
+        if (failed) fprintf(stderr, ", %d failed", failed);
+        fprintf(stderr, ".\n");
+        ret = failed ? 1 : 0;
+    } else {
+        SkyRenderer *renderer = sky_renderer_new();
+        if (renderer) {
+            ret = (sky_renderer_write_chart(renderer, output, format, width, height, &scene) == 0) ? 0 : 1;
+            sky_renderer_free(renderer);
+        }
+    }
+
+    target_list_cleanup();
+    free_catalog();
+    parallel_shutdown();
+    return ret;
+}
@@ -1,14 +1,8 @@
 #include "sky_model.h"
-#include <libnova/mercury.h>
-#include <libnova/venus.h>
-#include <libnova/mars.h>
-#include <libnova/jupiter.h>
-#include <libnova/saturn.h>
-#include <libnova/uranus.h>
-#include <libnova/neptune.h>
+#include "ephemeris.h"
 #include <libnova/sidereal_time.h>
 #include <libnova/angular_separation.h>
-#include <libnova/lunar.h>
+#include <math.h>
 
 double get_julian_day(DateTime dt) {
     struct ln_date date;
@@ -21,104 +15,243 @@ double get_julian_day(DateTime dt) {
     return ln_get_julian_day(&date) - dt.timezone_offset/24.0;
 }
 
-void get_horizontal_coordinates(double ra, double dec, Location loc, DateTime dt, double *alt, double *az) {
-    struct ln_lnlat_posn observer;
-    observer.lat = loc.lat;
-    observer.lng = loc.lon;
+DateTime datetime_from_julian_day(JulianDay jd, double timezone_offset) {
+    // Split the local JD into the civil day (starting at midnight, JD x.5)
+    // and milliseconds into it, so rounding never leaves 59.9999 s
+    double local = jd + timezone_offset / HOURS_PER_DAY + 0.5;
+    double day = floor(local);
+    double ms = floor((local - day) * 86400000.0 + 0.5);
+    if (ms >= 86400000.0) {
+        day += 1.0;
+        ms -= 86400000.0;
+    }
 
-    struct ln_equ_posn object;
-    object.ra = ra; // degrees
-    object.dec = dec; // degrees
+    struct ln_date date;
+    ln_get_date(day - 0.5 + 0.25, &date); // Mid-morning: only the calendar date is used
 
-    double JD = get_julian_day(dt);
+    DateTime dt;
+    dt.year = date.years;
+    dt.month = date.months;
+    dt.day = date.days;
+    int secs = (int)(ms / 1000.0);
+    dt.hour = secs / 3600;
+    dt.minute = (secs / 60) % 60;
+    dt.second = (secs % 60) + (ms - secs * 1000.0) / 1000.0;
+    dt.timezone_offset = timezone_offset;
+    return dt;
+}
+
+DateTime datetime_add_hours(DateTime dt, double hours) {
+    return datetime_from_julian_day(get_julian_day(dt) + hours / HOURS_PER_DAY, dt.timezone_offset);
+}
 
-    struct ln_hrz_posn hrz;
-    ln_get_hrz_from_equ(&object, &observer, JD, &hrz);
+static void horizontal_from_vector(const double h[3], double zenith_az, double *alt, double *az) {
+    double z = h[2];
+    if (z > 1.0) z = 1.0;
+    if (z < -1.0) z = -1.0;
+    *alt = asin(z) * (180.0 / M_PI);
 
-    *alt = hrz.alt;
-    *az = hrz.az;
+    if (fabs(h[0]) < 1e-12 && fabs(h[1]) < 1e-12) {
+        *az = zenith_az; // At the zenith/nadir, azimuth is undefined
+        return;
+    }
+    double A = atan2(h[1], h[0]) * (180.0 / M_PI);
+    if (A < 0) A += 360.0;
+    *az = A;
 }
 
-void get_equatorial_coordinates(double alt, double az, Location loc, DateTime dt, double *ra, double *dec) {
-    struct ln_lnlat_posn observer;
-    observer.lat = loc.lat;
-    observer.lng = loc.lon;
+static void equ_to_horizontal(const ObserverFrame *frame, double ra, double dec, double *alt, double *az) {
+    double ra_rad = ra * (M_PI / 180.0);
+    double dec_rad = dec * (M_PI / 180.0);
+    double cos_dec = cos(dec_rad);
+    double v[3] = {cos_dec * cos(ra_rad), cos_dec * sin(ra_rad), sin(dec_rad)};
 
-    struct ln_hrz_posn hrz;
-    hrz.az = az;
-    hrz.alt = alt;
+    double h[3];
+    for (int r = 0; r < 3; r++) {
+        h[r] = frame->rot[r][0] * v[0] + frame->rot[r][1] * v[1] + frame->rot[r][2] * v[2];
+    }
+    horizontal_from_vector(h, (frame->loc.lat > 0) ? 180.0 : 0.0, alt, az);
+}
 
-    double JD = get_julian_day(dt);
+// Fills in LST, site trig and the rotation from the Greenwich sidereal time
+static void frame_set_sidereal_time(ObserverFrame *frame, double gast) {
+    while (gast < 0.0) gast += 24.0;
+    while (gast >= 24.0) gast -= 24.0;
+    frame->gast = gast;
+
+    double lst = gast + frame->loc.lon / 15.0;
+    while (lst < 0.0) lst += 24.0;
+    while (lst >= 24.0) lst -= 24.0;
+    frame->lst = lst;
 
-    struct ln_equ_posn equ;
-    ln_get_equ_from_hrz(&hrz, &observer, JD, &equ);
+    double lat_rad = frame->loc.lat * M_PI / 180.0;
+    frame->sin_lat = sin(lat_rad);
+    frame->cos_lat = cos(lat_rad);
 
-    if (ra) *ra = equ.ra;
-    if (dec) *dec = equ.dec;
+    // Hour angle H = LST - RA. Expanding the formulas used by
+    // ln_get_hrz_from_equ in terms of the equatorial unit vector gives:
+    //   cos(alt) cos(az) = sin(lat) cos(dec) cos(H) - cos(lat) sin(dec)
+    //   cos(alt) sin(az) = cos(dec) sin(H)
+    //   sin(alt)         = cos(lat) cos(dec) cos(H) + sin(lat) sin(dec)
+    double theta = lst * (M_PI / 12.0);
+    double sin_t = sin(theta);
+    double cos_t = cos(theta);
+    frame->rot[0][0] = frame->sin_lat * cos_t;
+    frame->rot[0][1] = frame->sin_lat * sin_t;
+    frame->rot[0][2] = -frame->cos_lat;
+    frame->rot[1][0] = sin_t;
+    frame->rot[1][1] = -cos_t;
+    frame->rot[1][2] = 0.0;
+    frame->rot[2][0] = frame->cos_lat * cos_t;
+    frame->rot[2][1] = frame->cos_lat * sin_t;
+    frame->rot[2][2] = frame->sin_lat;
 }
 
-void get_sun_position(Location loc, DateTime dt, double *alt, double *az) {
-    double JD = get_julian_day(dt);
-    struct ln_lnlat_posn observer;
-    observer.lat = loc.lat;
-    observer.lng = loc.lon;
+void observer_frame_init(ObserverFrame *frame, Location loc, DateTime dt) {
+    observer_frame_init_jd(frame, loc, get_julian_day(dt));
+}
 
-    struct ln_equ_posn equ;
-    ln_get_solar_equ_coords(JD, &equ);
+void observer_frame_advance(ObserverFrame *frame, Location loc, DateTime dt) {
+    observer_frame_advance_jd(frame, loc, get_julian_day(dt));
+}
 
-    struct ln_hrz_posn hrz;
-    ln_get_hrz_from_equ(&equ, &observer, JD, &hrz);
+void observer_frame_init_jd(ObserverFrame *frame, Location loc, JulianDay jd) {
+    frame->loc = loc;
+    frame->jd = jd;
 
-    *alt = hrz.alt;
-    *az = hrz.az;
+    // Full solve: apparent sidereal time including nutation
+    frame->solve_jd = frame->jd;
+    ephemeris_libnova_lock();
+    frame->solve_gast = ln_get_apparent_sidereal_time(frame->jd);
+    ephemeris_libnova_unlock();
+    frame_set_sidereal_time(frame, frame->solve_gast);
 }
 
-void get_moon_position(Location loc, DateTime dt, double *alt, double *az) {
-    double JD = get_julian_day(dt);
-    struct ln_lnlat_posn observer;
-    observer.lat = loc.lat;
-    observer.lng = loc.lon;
+void observer_frame_advance_jd(ObserverFrame *frame, Location loc, JulianDay jd) {
+    double delta = jd - frame->solve_jd;
+    if (loc.lat != frame->loc.lat || loc.lon != frame->loc.lon || fabs(delta) > OBSERVER_FRAME_RIGID_DAYS) {
+        observer_frame_init_jd(frame, loc, jd);
+        return;
+    }
 
-    struct ln_equ_posn equ;
-    ln_get_lunar_equ_coords(JD, &equ);
+    // Fixed stars only turn about the pole: advance sidereal time from the last
+    // full solve at the sidereal rate. The equation of the equinoxes (nutation
+    // in RA) is held at its solve value; its 13.7 and 182.6 day terms move it
+    // by up to about 0.15" (0.01 s of sidereal time) over the rigid window.
+    frame->loc = loc;
+    frame->jd = jd;
+    frame_set_sidereal_time(frame, frame->solve_gast + delta * SIDEREAL_HOURS_PER_DAY);
+}
 
-    struct ln_hrz_posn hrz;
-    ln_get_hrz_from_equ(&equ, &observer, JD, &hrz);
+void observer_frame_get_horizontal(const ObserverFrame *frame, double ra, double dec, double *alt, double *az) {
+    equ_to_horizontal(frame, ra, dec, alt, az);
+}
 
-    *alt = hrz.alt;
-    *az = hrz.az;
+void observer_frame_get_horizontal_batch(const ObserverFrame *frame, const double *ra, const double *dec, int count, double *alt, double *az) {
+    for (int i = 0; i < count; i++) {
+        equ_to_horizontal(frame, ra[i], dec[i], &alt[i], &az[i]);
+    }
 }
 
-void get_planet_position(PlanetID planet, Location loc, DateTime dt, double *alt, double *az, double *ra, double *dec) {
-    double JD = get_julian_day(dt);
-    struct ln_lnlat_posn observer;
-    observer.lat = loc.lat;
-    observer.lng = loc.lon;
-    struct ln_equ_posn equ = {0, 0};
-
-    switch(planet) {
-        case PLANET_MERCURY: ln_get_mercury_equ_coords(JD, &equ); break;
-        case PLANET_VENUS:   ln_get_venus_equ_coords(JD, &equ); break;
-        case PLANET_MARS:    ln_get_mars_equ_coords(JD, &equ); break;
-        case PLANET_JUPITER: ln_get_jupiter_equ_coords(JD, &equ); break;
-        case PLANET_SATURN:  ln_get_saturn_equ_coords(JD, &equ); break;
-        case PLANET_URANUS:  ln_get_uranus_equ_coords(JD, &equ); break;
-        case PLANET_NEPTUNE: ln_get_neptune_equ_coords(JD, &equ); break;
+void observer_frame_get_horizontal_vectors(const ObserverFrame *frame, const double *x, const double *y, const double *z, const int *index, int count, double *alt, double *az) {
+    double zenith_az = (frame->loc.lat > 0) ? 180.0 : 0.0;
+    for (int n = 0; n < count; n++) {
+        int i = index ? index[n] : n;
+        double h[3];
+        for (int r = 0; r < 3; r++) {
+            h[r] = frame->rot[r][0] * x[i] + frame->rot[r][1] * y[i] + frame->rot[r][2] * z[i];
+        }
+        horizontal_from_vector(h, zenith_az, &alt[n], &az[n]);
+    }
+}
+
+void observer_frame_get_equatorial(const ObserverFrame *frame, double alt, double az, double *ra, double *dec) {
+    double alt_rad = alt * (M_PI / 180.0);
+    double az_rad = az * (M_PI / 180.0);
+    double cos_alt = cos(alt_rad);
+    double h[3] = {cos_alt * cos(az_rad), cos_alt * sin(az_rad), sin(alt_rad)};
+
+    // The rotation is orthonormal, so its inverse is the transpose
+    double v[3];
+    for (int c = 0; c < 3; c++) {
+        v[c] = frame->rot[0][c] * h[0] + frame->rot[1][c] * h[1] + frame->rot[2][c] * h[2];
     }
 
-    if (ra) *ra = equ.ra;
-    if (dec) *dec = equ.dec;
+    double z = v[2];
+    if (z > 1.0) z = 1.0;
+    if (z < -1.0) z = -1.0;
+    double r = atan2(v[1], v[0]) * (180.0 / M_PI);
+    if (r < 0) r += 360.0;
+
+    if (ra) *ra = r;
+    if (dec) *dec = asin(z) * (180.0 / M_PI);
+}
+
+void observer_frame_get_sun_position(const ObserverFrame *frame, double *alt, double *az) {
+    double ra, dec;
+    ephemeris_get_equ(EPHEMERIS_SUN, frame->jd, &ra, &dec);
+    equ_to_horizontal(frame, ra, dec, alt, az);
+}
+
+void observer_frame_get_moon_position(const ObserverFrame *frame, double *alt, double *az) {
+    double ra, dec;
+    ephemeris_get_equ(EPHEMERIS_MOON, frame->jd, &ra, &dec);
+    equ_to_horizontal(frame, ra, dec, alt, az);
+}
+
+void observer_frame_get_planet_position(const ObserverFrame *frame, PlanetID planet, double *alt, double *az, double *ra, double *dec) {
+    double p_ra, p_dec;
+    ephemeris_get_equ(EPHEMERIS_PLANET(planet), frame->jd, &p_ra, &p_dec);
 
-    struct ln_hrz_posn hrz;
-    ln_get_hrz_from_equ(&equ, &observer, JD, &hrz);
+    if (ra) *ra = p_ra;
+    if (dec) *dec = p_dec;
+
+    equ_to_horizontal(frame, p_ra, p_dec, alt, az);
+}
+
+// Single-shot helpers kept for callers that only need one object
+void get_horizontal_coordinates(double ra, double dec, Location loc, DateTime dt, double *alt, double *az) {
+    ObserverFrame frame;
+    observer_frame_init(&frame, loc, dt);
+    observer_frame_get_horizontal(&frame, ra, dec, alt, az);
+}
 
-    *alt = hrz.alt;
-    *az = hrz.az;
+void get_horizontal_coordinates_batch(const double *ra, const double *dec, int count, Location loc, DateTime dt, double *alt, double *az) {
+    ObserverFrame frame;
+    observer_frame_init(&frame, loc, dt);
+    observer_frame_get_horizontal_batch(&frame, ra, dec, count, alt, az);
+}
+
+void get_equatorial_coordinates(double alt, double az, Location loc, DateTime dt, double *ra, double *dec) {
+    ObserverFrame frame;
+    observer_frame_init(&frame, loc, dt);
+    observer_frame_get_equatorial(&frame, alt, az, ra, dec);
+}
+
+void get_sun_position(Location loc, DateTime dt, double *alt, double *az) {
+    ObserverFrame frame;
+    observer_frame_init(&frame, loc, dt);
+    observer_frame_get_sun_position(&frame, alt, az);
+}
+
+void get_moon_position(Location loc, DateTime dt, double *alt, double *az) {
+    ObserverFrame frame;
+    observer_frame_init(&frame, loc, dt);
+    observer_frame_get_moon_position(&frame, alt, az);
+}
+
+void get_planet_position(PlanetID planet, Location loc, DateTime dt, double *alt, double *az, double *ra, double *dec) {
+    ObserverFrame frame;
+    observer_frame_init(&frame, loc, dt);
+    observer_frame_get_planet_position(&frame, planet, alt, az, ra, dec);
 }
 
 double get_lst(DateTime dt, Location loc) {
     double JD = get_julian_day(dt);
-    return ln_get_apparent_sidereal_time(JD) + loc.lon / 15.0; // Approximation, libnova might handle lon in sidereal func?
+    ephemeris_libnova_lock();
+    double gast = ln_get_apparent_sidereal_time(JD);
+    ephemeris_libnova_unlock();
+    return gast + loc.lon / 15.0; // Approximation, libnova might handle lon in sidereal func?
     // ln_get_apparent_sidereal_time returns Mean Sidereal Time at Greenwich in hours.
     // LST = GST + lon_hours
 }
@@ -130,9 +263,5 @@ double get_angular_separation(double ra1, double dec1, double ra2, double dec2)
 }
 
 void get_moon_equ_coords(DateTime dt, double *ra, double *dec) {
-    double JD = get_julian_day(dt);
-    struct ln_equ_posn equ;
-    ln_get_lunar_equ_coords(JD, &equ);
-    *ra = equ.ra;
-    *dec = equ.dec;
+    ephemeris_get_equ(EPHEMERIS_MOON, get_julian_day(dt), ra, dec);
 }
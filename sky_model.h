@@ -19,6 +19,13 @@ typedef struct {
     double timezone_offset; // hours from UTC
 } DateTime;
 
+// An instant as a UT Julian day. Time arithmetic (offsets, differences,
+// sampling a night) is plain floating point on these; DateTime is the civil
+// form, in the zone given by its timezone_offset, for display and input.
+typedef double JulianDay;
+
+#define HOURS_PER_DAY 24.0
+
 typedef enum {
     PLANET_MERCURY,
     PLANET_VENUS,
@@ -29,12 +36,61 @@ typedef enum {
     PLANET_NEPTUNE
 } PlanetID;
 
+// Observer/frame context for one site and instant. Holds everything needed to
+// go between equatorial and horizontal coordinates so that the setup (JD,
+// sidereal time, site trig) is paid once per frame instead of once per object.
+typedef struct {
+    Location loc;
+    JulianDay jd; // UT
+    double gast; // Apparent sidereal time at Greenwich (hours)
+    double solve_jd; // JD of the last full sidereal time solve
+    double solve_gast; // Its apparent sidereal time (hours); see observer_frame_advance()
+    double lst; // Local apparent sidereal time (hours, 0..24)
+    double sin_lat;
+    double cos_lat;
+    // Rotation taking an equatorial unit vector (x towards RA 0, z towards the
+    // pole) to a horizontal one (x towards Az 0 = South, y towards Az 90 = West,
+    // z towards the zenith).
+    double rot[3][3];
+} ObserverFrame;
+
+// Sidereal hours elapsed per solar day
+#define SIDEREAL_HOURS_PER_DAY 24.065709824419
+// Time steps within this many days of a frame's last full solve reuse it, at
+// up to about 0.15" of error from the nutation held fixed
+#define OBSERVER_FRAME_RIGID_DAYS 1.0
+
+void observer_frame_init(ObserverFrame *frame, Location loc, DateTime dt);
+// Moves an initialised frame to a new time. Small steps (the common case when
+// scrubbing time) only rotate the frame by the sidereal time difference; a site
+// change or a step past OBSERVER_FRAME_RIGID_DAYS falls back to a full init.
+void observer_frame_advance(ObserverFrame *frame, Location loc, DateTime dt);
+// Same as the two above for an instant given as a Julian day
+void observer_frame_init_jd(ObserverFrame *frame, Location loc, JulianDay jd);
+void observer_frame_advance_jd(ObserverFrame *frame, Location loc, JulianDay jd);
+void observer_frame_get_horizontal(const ObserverFrame *frame, double ra, double dec, double *alt, double *az);
+void observer_frame_get_horizontal_batch(const ObserverFrame *frame, const double *ra, const double *dec, int count, double *alt, double *az);
+// Same as the batch above for precomputed equatorial unit vectors. If index is
+// non-NULL, output n is computed from element index[n] of x/y/z.
+void observer_frame_get_horizontal_vectors(const ObserverFrame *frame, const double *x, const double *y, const double *z, const int *index, int count, double *alt, double *az);
+void observer_frame_get_equatorial(const ObserverFrame *frame, double alt, double az, double *ra, double *dec);
+void observer_frame_get_sun_position(const ObserverFrame *frame, double *alt, double *az);
+void observer_frame_get_moon_position(const ObserverFrame *frame, double *alt, double *az);
+void observer_frame_get_planet_position(const ObserverFrame *frame, PlanetID planet, double *alt, double *az, double *ra, double *dec);
+
 void get_horizontal_coordinates(double ra, double dec, Location loc, DateTime dt, double *alt, double *az);
+// Batch variant for callers without a frame: one frame solve for all `count` objects
+void get_horizontal_coordinates_batch(const double *ra, const double *dec, int count, Location loc, DateTime dt, double *alt, double *az);
 void get_equatorial_coordinates(double alt, double az, Location loc, DateTime dt, double *ra, double *dec);
 void get_sun_position(Location loc, DateTime dt, double *alt, double *az);
 void get_moon_position(Location loc, DateTime dt, double *alt, double *az);
 void get_planet_position(PlanetID planet, Location loc, DateTime dt, double *alt, double *az, double *ra, double *dec);
 double get_julian_day(DateTime dt);
+
+// Civil time in the given zone (hours east of UTC), seconds rounded to the millisecond
+DateTime datetime_from_julian_day(JulianDay jd, double timezone_offset);
+// DateTime arithmetic through the Julian day, independent of the host time zone
+DateTime datetime_add_hours(DateTime dt, double hours);
 double get_lst(DateTime dt, Location loc);
 double get_angular_separation(double ra1, double dec1, double ra2, double dec2);
 void get_moon_equ_coords(DateTime dt, double *ra, double *dec);
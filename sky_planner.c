@@ -0,0 +1,548 @@
+// sky_planner: headless night planning. Computes rise, transit, set, highest
+// altitude and the windows below an airmass limit during astronomical night
+// for every target of a saved list (and optionally catalog stars), and writes
+// them as CSV or JSON. Needs no display; GTK is never initialised.
+#include "catalog.h"
+#include "ephemeris.h"
+#include "parallel.h"
+#include "site.h"
+#include "sky_model.h"
+#include "target_list.h"
+#include <getopt.h>
+#include <jansson.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STAR_HORIZON -0.5667 // Rise/set altitude: refraction at the horizon
+#define MAX_WINDOWS 3 // A night is shorter than two sidereal days
+#define SUN_SAMPLE_MINUTES 10
+#define SUN_CROSSING_ITERATIONS 10
+
+typedef enum {
+    VISIBILITY_RISES_AND_SETS,
+    VISIBILITY_CIRCUMPOLAR,
+    VISIBILITY_NEVER_RISES
+} Visibility;
+
+typedef struct {
+    JulianDay start;
+    JulianDay end;
+} TimeWindow;
+
+typedef struct {
+    Visibility visibility;
+    JulianDay rise, transit, set; // First of each after local noon; rise/set -1 if none
+    double max_alt; // Highest altitude during the night (NAN without a night)
+    JulianDay max_alt_time;
+    int num_windows;
+    TimeWindow windows[MAX_WINDOWS]; // Dark and below the airmass limit
+    double hours; // Total length of the windows
+} TargetPlan;
+
+// Everything shared by the per-target work; read-only while planning
+typedef struct {
+    Location loc;
+    JulianDay jd_noon; // Local noon on the planning date
+    double lst0; // Local sidereal time at jd_noon (hours)
+    int has_night;
+    TimeWindow night; // Sun below the twilight limit
+    double alt_limit; // Altitude of the airmass limit (degrees)
+    const Target *targets;
+    TargetPlan *plans;
+} PlanContext;
+
+static double wrap_hours(double h) {
+    h = fmod(h, 24.0);
+    if (h < 0) h += 24.0;
+    return h;
+}
+
+// First instant after local noon at which the hour angle of RA ra_h is ha_h.
+// The sidereal time runs rigidly from the noon solve, as in observer frames.
+static JulianDay first_hour_angle(const PlanContext *ctx, double ra_h, double ha_h) {
+    return ctx->jd_noon + wrap_hours(ra_h + ha_h - ctx->lst0) / SIDEREAL_HOURS_PER_DAY;
+}
+
+// Hour angle (hours) at which a declination crosses an altitude: 12 if it is
+// always above, -1 if it never gets there
+static double crossing_hour_angle(double lat, double dec, double alt) {
+    double lat_rad = lat * (M_PI / 180.0);
+    double dec_rad = dec * (M_PI / 180.0);
+    double denom = cos(lat_rad) * cos(dec_rad);
+    double num = sin(alt * (M_PI / 180.0)) - sin(lat_rad) * sin(dec_rad);
+    if (fabs(denom) < 1e-12) return (num <= 0) ? 12.0 : -1.0;
+    double c = num / denom;
+    if (c <= -1.0) return 12.0;
+    if (c >= 1.0) return -1.0;
+    return acos(c) * (180.0 / M_PI) / 15.0;
+}
+
+static double altitude_at(const PlanContext *ctx, double ra_h, double dec, JulianDay jd) {
+    double lst = ctx->lst0 + (jd - ctx->jd_noon) * SIDEREAL_HOURS_PER_DAY;
+    double ha = (lst - ra_h) * (M_PI / 12.0);
+    double lat_rad = ctx->loc.lat * (M_PI / 180.0);
+    double dec_rad = dec * (M_PI / 180.0);
+    double s = sin(lat_rad) * sin(dec_rad) + cos(lat_rad) * cos(dec_rad) * cos(ha);
+    if (s > 1.0) s = 1.0;
+    if (s < -1.0) s = -1.0;
+    return asin(s) * (180.0 / M_PI);
+}
+
+// Fixed stars only turn with the sky, so every event has a closed form in the
+// hour angle; no sampling is needed per target
+static void plan_target(const PlanContext *ctx, const Target *tgt, TargetPlan *plan) {
+    double ra_h = tgt->ra / 15.0;
+    double sidereal_day = HOURS_PER_DAY / SIDEREAL_HOURS_PER_DAY;
+
+    plan->transit = first_hour_angle(ctx, ra_h, 0.0);
+    plan->rise = -1;
+    plan->set = -1;
+    double h_rs = crossing_hour_angle(ctx->loc.lat, tgt->dec, STAR_HORIZON);
+    if (h_rs >= 12.0) {
+        plan->visibility = VISIBILITY_CIRCUMPOLAR;
+    } else if (h_rs < 0) {
+        plan->visibility = VISIBILITY_NEVER_RISES;
+    } else {
+        plan->visibility = VISIBILITY_RISES_AND_SETS;
+        plan->rise = first_hour_angle(ctx, ra_h, -h_rs);
+        plan->set = first_hour_angle(ctx, ra_h, h_rs);
+    }
+
+    plan->num_windows = 0;
+    plan->hours = 0.0;
+    plan->max_alt = NAN;
+    plan->max_alt_time = -1;
+    if (!ctx->has_night) return;
+
+    // Highest point: an upper transit inside the night, else one of its ends
+    const TimeWindow *night = &ctx->night;
+    double alt_start = altitude_at(ctx, ra_h, tgt->dec, night->start);
+    double alt_end = altitude_at(ctx, ra_h, tgt->dec, night->end);
+    plan->max_alt = alt_start;
+    plan->max_alt_time = night->start;
+    if (alt_end > plan->max_alt) {
+        plan->max_alt = alt_end;
+        plan->max_alt_time = night->end;
+    }
+    for (int k = -1; k <= 1; k++) {
+        JulianDay tr = plan->transit + k * sidereal_day;
+        if (tr >= night->start && tr <= night->end) {
+            plan->max_alt = 90.0 - fabs(ctx->loc.lat - tgt->dec);
+            plan->max_alt_time = tr;
+            break;
+        }
+    }
+
+    double h_lim = crossing_hour_angle(ctx->loc.lat, tgt->dec, ctx->alt_limit);
+    if (h_lim < 0) return;
+    if (h_lim >= 12.0) {
+        plan->windows[0] = *night;
+        plan->num_windows = 1;
+    } else {
+        double half = h_lim / SIDEREAL_HOURS_PER_DAY;
+        for (int k = -1; k <= 1 && plan->num_windows < MAX_WINDOWS; k++) {
+            JulianDay tr = plan->transit + k * sidereal_day;
+            TimeWindow w = {fmax(tr - half, night->start), fmin(tr + half, night->end)};
+            if (w.end > w.start) plan->windows[plan->num_windows++] = w;
+        }
+    }
+    for (int w = 0; w < plan->num_windows; w++) {
+        plan->hours += (plan->windows[w].end - plan->windows[w].start) * HOURS_PER_DAY;
+    }
+}
+
+static void plan_chunk(int begin, int end, void *data) {
+    const PlanContext *ctx = data;
+    for (int i = begin; i < end; i++) {
+        plan_target(ctx, &ctx->targets[i], &ctx->plans[i]);
+    }
+}
+
+static double sun_altitude(ObserverFrame *frame, Location loc, JulianDay jd) {
+    observer_frame_advance_jd(frame, loc, jd);
+    double alt, az;
+    observer_frame_get_sun_position(frame, &alt, &az);
+    return alt;
+}
+
+// Bisects a crossing of sun_limit bracketed by lo and hi
+static JulianDay refine_sun_crossing(ObserverFrame *frame, Location loc, double sun_limit, JulianDay lo, double alt_lo, JulianDay hi) {
+    for (int it = 0; it < SUN_CROSSING_ITERATIONS; it++) {
+        JulianDay mid = 0.5 * (lo + hi);
+        double alt = sun_altitude(frame, loc, mid);
+        if ((alt < sun_limit) == (alt_lo < sun_limit)) lo = mid;
+        else hi = mid;
+    }
+    return 0.5 * (lo + hi);
+}
+
+// Finds the first stretch between this noon and the next with the Sun below
+// sun_limit
+static void find_night(PlanContext *ctx, double sun_limit) {
+    ObserverFrame frame;
+    observer_frame_init_jd(&frame, ctx->loc, ctx->jd_noon);
+    ctx->lst0 = frame.lst;
+
+    int samples = (int)(HOURS_PER_DAY * 60 / SUN_SAMPLE_MINUTES);
+    double step = 1.0 / samples;
+    ctx->has_night = 0;
+
+    double prev = sun_altitude(&frame, ctx->loc, ctx->jd_noon);
+    if (prev < sun_limit) {
+        ctx->has_night = 1;
+        ctx->night.start = ctx->jd_noon;
+    }
+    for (int k = 1; k <= samples; k++) {
+        JulianDay jd = ctx->jd_noon + k * step;
+        double alt = sun_altitude(&frame, ctx->loc, jd);
+        if (!ctx->has_night && prev >= sun_limit && alt < sun_limit) {
+            ctx->has_night = 1;
+            ctx->night.start = refine_sun_crossing(&frame, ctx->loc, sun_limit, jd - step, prev, jd);
+        } else if (ctx->has_night && prev < sun_limit && alt >= sun_limit) {
+            ctx->night.end = refine_sun_crossing(&frame, ctx->loc, sun_limit, jd - step, prev, jd);
+            return;
+        }
+        prev = alt;
+    }
+    if (ctx->has_night) ctx->night.end = ctx->jd_noon + 1.0;
+}
+
+// Local civil time of an instant, "" for none
+static void format_time(JulianDay jd, double tz, char *buf, size_t len) {
+    if (jd < 0) {
+        buf[0] = '\0';
+        return;
+    }
+    DateTime dt = datetime_from_julian_day(jd, tz);
+    snprintf(buf, len, "%04d-%02d-%02dT%02d:%02d:%02d", dt.year, dt.month, dt.day, dt.hour, dt.minute, (int)dt.second);
+}
+
+static const char *visibility_name(Visibility v) {
+    switch (v) {
+        case VISIBILITY_CIRCUMPOLAR: return "circumpolar";
+        case VISIBILITY_NEVER_RISES: return "never_rises";
+        default: return "rises_and_sets";
+    }
+}
+
+// Quotes a CSV field if it needs it
+static void write_csv_field(FILE *out, const char *s) {
+    if (strpbrk(s, ",\"\n") == NULL) {
+        fputs(s, out);
+        return;
+    }
+    fputc('"', out);
+    for (const char *p = s; *p; p++) {
+        if (*p == '"') fputc('"', out);
+        fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static void write_csv(FILE *out, const PlanContext *ctx, int count, double tz) {
+    fprintf(out, "name,ra,dec,mag,visibility,rise,transit,set,max_alt,max_alt_time,min_airmass,hours,windows\n");
+    for (int i = 0; i < count; i++) {
+        const Target *tgt = &ctx->targets[i];
+        const TargetPlan *plan = &ctx->plans[i];
+        char rise[32], transit[32], set[32], max_time[32];
+        format_time(plan->rise, tz, rise, sizeof(rise));
+        format_time(plan->transit, tz, transit, sizeof(transit));
+        format_time(plan->set, tz, set, sizeof(set));
+        format_time(plan->max_alt_time, tz, max_time, sizeof(max_time));
+
+        write_csv_field(out, tgt->name);
+        fprintf(out, ",%.6f,%.6f,%.2f,%s,%s,%s,%s,", tgt->ra, tgt->dec, tgt->mag, visibility_name(plan->visibility), rise, transit, set);
+        if (isfinite(plan->max_alt)) fprintf(out, "%.2f", plan->max_alt);
+        fprintf(out, ",%s,", max_time);
+        if (isfinite(plan->max_alt) && plan->max_alt > 0) fprintf(out, "%.3f", 1.0 / sin(plan->max_alt * M_PI / 180.0));
+        fprintf(out, ",%.2f,", plan->hours);
+        // ISO 8601 intervals, ';' between windows
+        for (int w = 0; w < plan->num_windows; w++) {
+            char start[32], end[32];
+            format_time(plan->windows[w].start, tz, start, sizeof(start));
+            format_time(plan->windows[w].end, tz, end, sizeof(end));
+            fprintf(out, "%s%s/%s", w ? ";" : "", start, end);
+        }
+        fputc('\n', out);
+    }
+}
+
+static json_t *json_time(JulianDay jd, double tz) {
+    if (jd < 0) return json_null();
+    char buf[32];
+    format_time(jd, tz, buf, sizeof(buf));
+    return json_string(buf);
+}
+
+static int write_json(FILE *out, const PlanContext *ctx, int count, double tz, const char *site_name, const char *date, double airmass, double sun_limit) {
+    json_t *root = json_object();
+
+    json_t *site = json_object();
+    if (site_name) json_object_set_new(site, "name", json_string(site_name));
+    json_object_set_new(site, "lat", json_real(ctx->loc.lat));
+    json_object_set_new(site, "lon", json_real(ctx->loc.lon));
+    json_object_set_new(site, "elevation", json_real(ctx->loc.elevation));
+    json_object_set_new(site, "timezone_offset", json_real(tz));
+    json_object_set_new(root, "site", site);
+    json_object_set_new(root, "date", json_string(date));
+    json_object_set_new(root, "airmass_limit", json_real(airmass));
+    json_object_set_new(root, "sun_altitude_limit", json_real(sun_limit));
+    if (ctx->has_night) {
+        json_t *night = json_object();
+        json_object_set_new(night, "start", json_time(ctx->night.start, tz));
+        json_object_set_new(night, "end", json_time(ctx->night.end, tz));
+        json_object_set_new(root, "night", night);
+    } else {
+        json_object_set_new(root, "night", json_null());
+    }
+
+    json_t *arr = json_array();
+    for (int i = 0; i < count; i++) {
+        const Target *tgt = &ctx->targets[i];
+        const TargetPlan *plan = &ctx->plans[i];
+        json_t *t = json_object();
+        json_object_set_new(t, "name", json_string(tgt->name));
+        json_object_set_new(t, "ra", json_real(tgt->ra));
+        json_object_set_new(t, "dec", json_real(tgt->dec));
+        json_object_set_new(t, "mag", json_real(tgt->mag));
+        json_object_set_new(t, "visibility", json_string(visibility_name(plan->visibility)));
+        json_object_set_new(t, "rise", json_time(plan->rise, tz));
+        json_object_set_new(t, "transit", json_time(plan->transit, tz));
+        json_object_set_new(t, "set", json_time(plan->set, tz));
+        if (isfinite(plan->max_alt)) {
+            json_object_set_new(t, "max_alt", json_real(plan->max_alt));
+            json_object_set_new(t, "max_alt_time", json_time(plan->max_alt_time, tz));
+            json_object_set_new(t, "min_airmass", plan->max_alt > 0 ? json_real(1.0 / sin(plan->max_alt * M_PI / 180.0)) : json_null());
+        } else {
+            json_object_set_new(t, "max_alt", json_null());
+            json_object_set_new(t, "max_alt_time", json_null());
+            json_object_set_new(t, "min_airmass", json_null());
+        }
+        json_object_set_new(t, "hours", json_real(plan->hours));
+        json_t *windows = json_array();
+        for (int w = 0; w < plan->num_windows; w++) {
+            json_t *win = json_object();
+            json_object_set_new(win, "start", json_time(plan->windows[w].start, tz));
+            json_object_set_new(win, "end", json_time(plan->windows[w].end, tz));
+            json_array_append_new(windows, win);
+        }
+        json_object_set_new(t, "windows", windows);
+        json_array_append_new(arr, t);
+    }
+    json_object_set_new(root, "targets", arr);
+
+    int ret = json_dumpf(root, out, JSON_INDENT(2));
+    fputc('\n', out);
+    json_decref(root);
+    return ret;
+}
+
+static void usage(FILE *out) {
+    fprintf(out,
+        "Usage: sky_planner --date YYYY-MM-DD (--site NAME | --lat DEG --lon DEG) [options]\n"
+        "  --site NAME        Built-in site (see --list-sites); a name prefix is enough\n"
+        "  --lat DEG, --lon DEG, --elevation M, --timezone HOURS\n"
+        "                     Custom site (east longitude and zone positive)\n"
+        "  --date YYYY-MM-DD  Local date of the evening the night starts\n"
+        "  --targets FILE     Target list saved by the application\n"
+        "  --stars MAG        Also plan every catalog star brighter than MAG\n"
+        "  --airmass X        Airmass limit for the windows (default 2.0)\n"
+        "  --sun-alt DEG      Sun altitude that ends twilight (default -18)\n"
+        "  --format csv|json  Output format (default csv)\n"
+        "  --output FILE      Write to FILE instead of standard output\n"
+        "  --threads N        Worker threads (default: one per CPU)\n"
+        "  --list-sites       Print the built-in sites and exit\n");
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"site", required_argument, NULL, 's'},
+        {"lat", required_argument, NULL, 'a'},
+        {"lon", required_argument, NULL, 'o'},
+        {"elevation", required_argument, NULL, 'e'},
+        {"timezone", required_argument, NULL, 'z'},
+        {"date", required_argument, NULL, 'd'},
+        {"targets", required_argument, NULL, 't'},
+        {"stars", required_argument, NULL, 'm'},
+        {"airmass", required_argument, NULL, 'x'},
+        {"sun-alt", required_argument, NULL, 'u'},
+        {"format", required_argument, NULL, 'f'},
+        {"output", required_argument, NULL, 'O'},
+        {"threads", required_argument, NULL, 'j'},
+        {"list-sites", no_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    const Site *site = NULL;
+    Location loc = {0, 0, 0};
+    int have_lat = 0, have_lon = 0;
+    double tz = 0.0;
+    int have_tz = 0;
+    const char *date = NULL;
+    const char *targets_file = NULL;
+    double star_limit = NAN;
+    double airmass = 2.0;
+    double sun_limit = -18.0;
+    const char *format = "csv";
+    const char *output = NULL;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+        switch (c) {
+            case 's':
+                site = site_find(optarg);
+                if (!site) {
+                    fprintf(stderr, "Unknown site '%s' (see --list-sites).\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'a': loc.lat = atof(optarg); have_lat = 1; break;
+            case 'o': loc.lon = atof(optarg); have_lon = 1; break;
+            case 'e': loc.elevation = atof(optarg); break;
+            case 'z': tz = atof(optarg); have_tz = 1; break;
+            case 'd': date = optarg; break;
+            case 't': targets_file = optarg; break;
+            case 'm': star_limit = atof(optarg); break;
+            case 'x': airmass = atof(optarg); break;
+            case 'u': sun_limit = atof(optarg); break;
+            case 'f': format = optarg; break;
+            case 'O': output = optarg; break;
+            case 'j': parallel_set_threads(atoi(optarg)); break;
+            case 'l':
+                for (int i = 0; sites[i].name != NULL; i++) {
+                    printf("%s\t%.4f\t%.4f\t%.0f\t%+.1f\n", sites[i].name, sites[i].lat, sites[i].lon, sites[i].elevation, sites[i].timezone_offset);
+                }
+                return 0;
+            case 'h':
+                usage(stdout);
+                return 0;
+            default:
+                usage(stderr);
+                return 1;
+        }
+    }
+
+    if (site) {
+        loc = site_location(site);
+        if (!have_tz) tz = site->timezone_offset;
+    } else if (!have_lat || !have_lon) {
+        fprintf(stderr, "A site is required: --site or --lat and --lon.\n");
+        usage(stderr);
+        return 1;
+    }
+
+    DateTime noon_dt = {0};
+    if (!date || sscanf(date, "%d-%d-%d", &noon_dt.year, &noon_dt.month, &noon_dt.day) != 3) {
+        fprintf(stderr, "A date is required: --date YYYY-MM-DD.\n");
+        return 1;
+    }
+    noon_dt.hour = 12;
+    noon_dt.timezone_offset = tz;
+
+    if (strcmp(format, "csv") != 0 && strcmp(format, "json") != 0) {
+        fprintf(stderr, "Unknown format '%s' (csv or json).\n", format);
+        return 1;
+    }
+    if (!(airmass >= 1.0)) {
+        fprintf(stderr, "The airmass limit must be at least 1.\n");
+        return 1;
+    }
+    if (!targets_file && isnan(star_limit)) {
+        fprintf(stderr, "Nothing to plan: give --targets and/or --stars.\n");
+        return 1;
+    }
+
+    // Targets: the saved list first, then catalog stars
+    target_list_init();
+    int count = 0;
+    TargetList *list = NULL;
+    if (targets_file) {
+        list = target_list_load(targets_file);
+        if (!list) {
+            fprintf(stderr, "Failed to load target list %s.\n", targets_file);
+            return 1;
+        }
+        count = target_list_get_count(list);
+    }
+    int star_count = 0;
+    if (!isnan(star_limit)) {
+        if (load_catalog() != 0) {
+            fprintf(stderr, "Failed to load catalog.\n");
+            target_list_cleanup();
+            return 1;
+        }
+        star_count = catalog_count_brighter(star_limit);
+    }
+
+    Target *targets = malloc(sizeof(Target) * (count + star_count + 1));
+    TargetPlan *plans = malloc(sizeof(TargetPlan) * (count + star_count + 1));
+    if (!targets || !plans) {
+        fprintf(stderr, "Out of memory for %d targets.\n", count + star_count);
+        free(targets);
+        free(plans);
+        target_list_cleanup();
+        free_catalog();
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        targets[i] = *target_list_get_target(list, i);
+    }
+    for (int i = 0; i < star_count; i++) {
+        Target *tgt = &targets[count + i];
+        const char *id = catalog_get_star_id(i);
+        if (id) snprintf(tgt->name, sizeof(tgt->name), "%s", id);
+        else snprintf(tgt->name, sizeof(tgt->name), "Star %d", i);
+        tgt->ra = star_catalog.ra[i];
+        tgt->dec = star_catalog.dec[i];
+        tgt->mag = star_catalog.mag[i];
+        tgt->bv = star_catalog.bv[i];
+    }
+    count += star_count;
+
+    PlanContext ctx;
+    ctx.loc = loc;
+    ctx.jd_noon = get_julian_day(noon_dt);
+    ctx.alt_limit = asin(1.0 / airmass) * (180.0 / M_PI); // Plane-parallel airmass sec(z)
+    ctx.targets = targets;
+    ctx.plans = plans;
+    find_night(&ctx, sun_limit);
+    if (!ctx.has_night) {
+        fprintf(stderr, "Warning: the Sun does not get below %.1f deg that night; no windows.\n", sun_limit);
+    }
+
+    parallel_for(count, 1024, plan_chunk, &ctx);
+
+    FILE *out = stdout;
+    if (output) {
+        out = fopen(output, "w");
+        if (!out) {
+            perror(output);
+            out = NULL;
+        }
+    }
+    int ret = 0;
+    if (!out) {
+        ret = 1;
+    } else if (strcmp(format, "json") == 0) {
+        if (write_json(out, &ctx, count, tz, site ? site->name : NULL, date, airmass, sun_limit) != 0) {
+            fprintf(stderr, "Failed to write JSON output.\n");
+            ret = 1;
+        }
+    } else {
+        write_csv(out, &ctx, count, tz);
+    }
+    if (out && out != stdout && fclose(out) != 0) {
+        perror(output);
+        ret = 1;
+    }
+
+    free(targets);
+    free(plans);
+    target_list_cleanup();
+    free_catalog();
+    parallel_shutdown();
+    return ret;
+}
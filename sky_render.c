@@ -0,0 +1,1880 @@
+#include "sky_render.h"
+#include "catalog.h"
+#include "star_index.h"
+#include "star_color.h"
+#include "parallel.h"
+#include "ephemeris.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <cairo-pdf.h>
+#include <cairo-svg.h>
+#include <libnova/julian_day.h>
+#include <libnova/rise_set.h>
+#include <libnova/solar.h>
+#include <libnova/lunar.h>
+#include <libnova/angular_separation.h>
+
+// Screen-space output of the star projection stage, one entry per batch star
+typedef struct {
+    double x, y;
+    double size;
+    double r, g, b; // Brightness already applied
+    int drawn; // Passed project(), i.e. above the horizon
+    int on_screen; // Counted in the "Stars: visible / total" box
+    unsigned int bucket; // Quantized size/colour key, see star_bucket_key()
+} StarSprite;
+
+// Star Buckets
+// Stars sharing a quantized radius and colour are drawn as one path with a
+// single fill instead of one fill each. Key layout: radius in quarter pixels
+// (10 bits) then 6 bits each of red, green and blue.
+#define STAR_COLOR_LEVELS 64
+#define STAR_SIZE_STEPS 4.0 // Radius quantization steps per pixel
+#define STAR_SIZE_MAX_Q 1023
+#define STAR_BUCKET_TABLE_BITS 15
+#define STAR_BUCKET_TABLE_SIZE (1 << STAR_BUCKET_TABLE_BITS)
+#define STAR_BUCKET_EMPTY 0xFFFFFFFFu
+
+#define STAR_PROJECTION_MIN_CHUNK 4096
+
+// Retained sky layer: everything but the cursor/hover overlays is rendered into
+// an image surface and reused while the scene it was drawn for is unchanged.
+// sky_renderer_invalidate() marks it dirty for changes the key cannot see
+// (target lists).
+typedef struct {
+    int width, height, scale;
+    SkyViewState view;
+    Location loc;
+    DateTime dt;
+    SkyViewOptions options;
+    const Target *highlighted;
+} SkyLayerKey;
+
+// Projection generation: bumped whenever the mapping from the sky to projected
+// u/v changes (time, site, projection or its centre). Cached u/v geometry is
+// stamped with the generation it was computed for; pan, zoom and rotation are
+// applied afterwards through view_matrix() and never invalidate it.
+typedef struct {
+    double jd, lat, lon;
+    int horizon_projection;
+    double horizon_center_az;
+} ProjectionKey;
+
+// Reference curve cache: grid and ecliptic polylines in alt/az (with their
+// projected u/v), rebuilt only for a new projection generation, grid spacing
+// or detail level. Curves are subdivided until the projected midpoint of each
+// segment is within CURVE_TOLERANCE_PX of its chord, so vertices concentrate
+// where the projection bends them; the detail level is the power of two below
+// the pixel scale, so panning, rotating and zooming within a level reuse the
+// cache.
+#define CURVE_INITIAL_STEP 10.0 // degrees of curve parameter
+#define CURVE_MAX_DEPTH 12
+#define CURVE_TOLERANCE_PX 0.5
+
+typedef struct {
+    int count, capacity;
+    double *alt, *az; // degrees
+    double *u, *v; // Projected, before the view transform
+    unsigned char *move; // 1 where a new subpath starts
+} SkyPolyline;
+
+// Equatorial and ecliptic curves move with time; the alt/az grid depends on
+// the projection only, so it is keyed apart and survives time steps
+typedef struct {
+    unsigned int generation;
+    double dec_step, ra_step;
+    int detail_level;
+} CurveCacheKey;
+
+typedef struct {
+    int horizon_projection;
+    double horizon_center_az;
+    double alt_step, az_step;
+    int detail_level;
+} AltAzGridKey;
+
+// Constellation line cache: the figures as u/v polylines, one subpath per
+// visible run, rebuilt for each projection generation. Figures whose bounding
+// cap is entirely below the horizon are skipped without transforming their
+// vertices; the rest record their vertex range and projected label position
+// so the draw can also skip figures outside the viewport.
+typedef struct {
+    int first, end; // Range in constellation_curves
+    double label_u, label_v;
+    int label_visible;
+    int in_view; // Set per draw from the viewport cap
+} ConstellationGeometry;
+
+struct SkyRenderer {
+    const SkyScene *scene; // The scene being drawn, set for the length of a draw
+
+    // Scratch buffers for the batched star transform
+    int star_batch_capacity;
+    int *star_batch_idx;
+    double *star_batch_alt;
+    double *star_batch_az;
+    int *star_stale_idx;
+
+    // Projected u/v of each catalog star (before the view transform), valid
+    // where star_uv_gen matches projection_generation
+    double *star_u;
+    double *star_v;
+    unsigned char *star_uv_visible;
+    unsigned int *star_uv_gen;
+
+    StarSprite *star_sprites;
+
+    unsigned int star_bucket_keys[STAR_BUCKET_TABLE_SIZE];
+    int star_bucket_head[STAR_BUCKET_TABLE_SIZE];
+    int star_bucket_tail[STAR_BUCKET_TABLE_SIZE];
+    int star_bucket_order[STAR_BUCKET_TABLE_SIZE]; // Used slots in first-use order
+    int star_bucket_table_ready;
+    int *star_bucket_next; // Per-sprite link to the next star of its bucket
+
+    // Rebuilt only when the size/brightness/saturation options change
+    StarColorTable star_colors;
+
+    cairo_surface_t *sky_layer;
+    SkyLayerKey sky_layer_key;
+    int sky_layer_dirty;
+
+    // Frame and Sun/Moon positions of the last layer, reused by the cursor box
+    ObserverFrame layer_frame;
+    int layer_frame_valid;
+    struct ln_equ_posn layer_sun_equ;
+    struct ln_equ_posn layer_moon_equ;
+
+    int cull_cells[STAR_INDEX_NPIX];
+
+    ProjectionKey projection_key;
+    unsigned int projection_generation; // 0: nothing projected yet
+
+    SkyPolyline altaz_grid_curves;
+    AltAzGridKey altaz_grid_key;
+    int altaz_grid_valid;
+    SkyPolyline radec_grid_curves;
+    SkyPolyline ecliptic_curve;
+    CurveCacheKey curve_cache_key;
+    int curve_cache_valid;
+
+    SkyPolyline constellation_curves;
+    ConstellationGeometry *constellation_geometry;
+    int constellation_geometry_count;
+    unsigned int constellation_generation;
+    double *constellation_alt; // Scratch, one entry per vertex
+    double *constellation_az;
+    int constellation_scratch_capacity;
+};
+
+// Inputs shared by every chunk of the projection stage (read-only while it runs)
+typedef struct {
+    SkyRenderer *r; // Each chunk writes only its own slice of the star buffers
+    const ObserverFrame *frame;
+    unsigned int generation; // projection_generation
+    const int *idx; // NULL: batch entry n is star n
+    cairo_matrix_t view; // u/v to layer pixels
+    int width, height;
+    const StarColorTable *lut; // Size, brightness and colour per quantized mag / B-V
+    int colors;
+} StarProjection;
+
+static unsigned int star_bucket_key(double size, double r, double g, double b) {
+    int size_q = (int)(size * STAR_SIZE_STEPS + 0.5);
+    if (size_q > STAR_SIZE_MAX_Q) size_q = STAR_SIZE_MAX_Q;
+    unsigned int rq = (unsigned int)(r * (STAR_COLOR_LEVELS - 1) + 0.5);
+    unsigned int gq = (unsigned int)(g * (STAR_COLOR_LEVELS - 1) + 0.5);
+    unsigned int bq = (unsigned int)(b * (STAR_COLOR_LEVELS - 1) + 0.5);
+    return ((unsigned int)size_q << 18) | (rq << 12) | (gq << 6) | bq;
+}
+
+// Projects Alt/Az to X/Y (0-1 range from center)
+// North Up, South Down. West Left, East Right.
+// Az 0=South, 180=North.
+int sky_project(const SkyViewState *view, double alt, double az, double *x, double *y) {
+    if (alt < 0) return 0;
+
+    if (view->horizon_projection) {
+        // Stereographic projection centered at (Az=horizon_center_az, Alt=0)
+        double alt_rad = alt * M_PI / 180.0;
+        double az_rad = az * M_PI / 180.0;
+        double center_az_rad = view->horizon_center_az * M_PI / 180.0;
+        double d_az = az_rad - center_az_rad;
+
+        // Cartesian on sphere (X towards view center)
+        double X = cos(alt_rad) * cos(d_az);
+        double Y = cos(alt_rad) * sin(d_az);
+        double Z = sin(alt_rad);
+
+        // Project from X=-1 plane to X=0 plane (or standard Stereographic from pole)
+        // Standard formula from center (1,0,0) to plane x=0:
+        // y' = Y / (1+X), z' = Z / (1+X)
+        // Check for point behind viewer
+        if (X <= -0.99) return 0; // Singularity at antipode
+
+        double k = 1.0 / (1.0 + X);
+        double x_proj = k * Y; // Horizontal
+        double y_proj = k * Z; // Vertical (Up)
+
+        // Map to screen coordinates
+        // Zenith mode: x is Right, y is Up (actually down in screen coords, handled by -r)
+        // Here x_proj is Right (if West is Right?).
+        // In Zenith mode: Az 90 (W) -> x=-r (Left). Az 270 (E) -> x=r (Right).
+        // Let's match that.
+        // If center=180 (N). Az=90(W) -> d_az = -90. sin(-90)=-1. Y=0. X=0. Wait.
+        // d_az = 90 - 180 = -90. cos(-90)=0. X=0. Y=-1. x_proj = -1.
+        // So W -> Left. Matches.
+
+        *x = x_proj;
+        *y = -y_proj; // y_proj is Up, Screen Y is Down.
+        return 1;
+    } else {
+        double r = 1.0 - alt / 90.0;
+        if (r < 0) r = 0;
+        double az_rad = az * M_PI / 180.0;
+        *x = r * sin(az_rad);
+        *y = r * cos(az_rad);
+        return 1;
+    }
+}
+
+// Apply View Transformation (Rotate -> Scale -> Pan)
+void sky_view_transform(const SkyViewState *view, double u, double v, double *tx, double *ty) {
+    double u_rot = u * cos(view->rotation) - v * sin(view->rotation);
+    double v_rot = u * sin(view->rotation) + v * cos(view->rotation);
+
+    double s_u = u_rot * view->zoom;
+    double s_v = v_rot * view->zoom;
+    *tx = s_u + view->pan_x;
+    *ty = s_v + view->pan_y;
+}
+
+void sky_view_untransform(const SkyViewState *view, double tx, double ty, double *u, double *v) {
+    double s_u = tx - view->pan_x;
+    double s_v = ty - view->pan_y;
+    double u_rot = s_u / view->zoom;
+    double v_rot = s_v / view->zoom;
+
+    *u = u_rot * cos(-view->rotation) - v_rot * sin(-view->rotation);
+    *v = u_rot * sin(-view->rotation) + v_rot * cos(-view->rotation);
+}
+
+// The view transform as a cairo matrix taking projected u/v to layer pixels
+// (cx + tx * radius, cy + ty * radius)
+static void view_matrix(const SkyViewState *view, cairo_matrix_t *m, double cx, double cy, double radius) {
+    double c = cos(view->rotation) * view->zoom * radius;
+    double s = sin(view->rotation) * view->zoom * radius;
+    cairo_matrix_init(m, c, s, -s, c, cx + view->pan_x * radius, cy + view->pan_y * radius);
+}
+
+void sky_unproject(const SkyViewState *view, double x, double y, double *alt, double *az) {
+    if (view->horizon_projection) {
+        // Inverse Stereographic
+        // x = k Y, y = -k Z
+        // Y = x/k, Z = -y/k
+        // k = 1/(1+X)
+        // x = Y/(1+X), -y = Z/(1+X)
+        // Let u = x, v = -y.
+        // rho^2 = u^2 + v^2.
+        // X = (1 - rho^2)/(1 + rho^2)
+        // Y = 2u / (1 + rho^2)
+        // Z = 2v / (1 + rho^2)
+
+        double u = x;
+        double v = -y;
+        double rho2 = u*u + v*v;
+        double X = (1.0 - rho2) / (1.0 + rho2);
+        double Y = 2.0 * u / (1.0 + rho2);
+        double Z = 2.0 * v / (1.0 + rho2);
+
+        *alt = asin(Z) * 180.0 / M_PI;
+        double d_az = atan2(Y, X) * 180.0 / M_PI;
+        *az = view->horizon_center_az + d_az;
+
+        while (*az < 0) *az += 360.0;
+        while (*az >= 360.0) *az -= 360.0;
+    } else {
+        double r = sqrt(x*x + y*y);
+        if (r > 1.0) {
+            *alt = -1; // Invalid
+            return;
+        }
+        *alt = 90.0 * (1.0 - r);
+        double angle = atan2(x, y);
+        *az = angle * 180.0 / M_PI;
+
+        if (*az < 0) *az += 360.0;
+        if (*az >= 360.0) *az -= 360.0;
+    }
+}
+
+static int project(const SkyRenderer *r, double alt, double az, double *x, double *y) {
+    return sky_project(&r->scene->view, alt, az, x, y);
+}
+
+static void transform_point(const SkyRenderer *r, double u, double v, double *tx, double *ty) {
+    sky_view_transform(&r->scene->view, u, v, tx, ty);
+}
+
+void sky_chart_geometry(int width, int height, double *cx, double *cy, double *radius) {
+    *radius = (width < height ? width : height) / 2.0 - 10;
+    *cx = width / 2.0;
+    *cy = height / 2.0;
+}
+
+// Viewport culling: only worth it once the view shows a small part of the sky
+#define CULL_MIN_ZOOM 2.0
+#define CULL_MAX_CAP_RADIUS 45.0 // degrees
+#define CULL_EDGE_SAMPLES 32
+#define CULL_EDGE_MARGIN_PX 20.0 // keeps stars whose disc pokes into the view
+
+static void altaz_to_vector(double alt, double az, double v[3]) {
+    double alt_rad = alt * M_PI / 180.0;
+    double az_rad = az * M_PI / 180.0;
+    v[0] = cos(alt_rad) * cos(az_rad);
+    v[1] = cos(alt_rad) * sin(az_rad);
+    v[2] = sin(alt_rad);
+}
+
+// Like sky_unproject() for a point of the transformed view, but continues the zenith
+// projection below the horizon (r up to 2) instead of rejecting it, so the
+// edge of a view hanging over the horizon still maps to the sphere.
+static int unproject_view_point(const SkyViewState *view, double tx, double ty, double v[3]) {
+    double u, w, alt, az;
+    sky_view_untransform(view, tx, ty, &u, &w);
+    if (!view->horizon_projection) {
+        double r = sqrt(u*u + w*w);
+        if (r >= 2.0) return 0;
+        alt = 90.0 * (1.0 - r);
+        az = atan2(u, w) * 180.0 / M_PI;
+    } else {
+        sky_unproject(view, u, w, &alt, &az);
+    }
+    altaz_to_vector(alt, az, v);
+    return 1;
+}
+
+// Spherical cap (centre alt/az, radius in degrees) holding everything the
+// viewport can show. The farthest visible point from the view centre lies on the
+// viewport edge, so sampling the edge gives the radius; the largest gap between
+// samples is added on top. Returns 0 when the view is too wide to bother.
+static int viewport_cap(const SkyViewState *view, int width, int height, double radius, double *cap_alt, double *cap_az, double *cap_radius) {
+    double c[3];
+    if (!unproject_view_point(view, 0.0, 0.0, c)) return 0;
+
+    double half_w = (width / 2.0 + CULL_EDGE_MARGIN_PX) / radius;
+    double half_h = (height / 2.0 + CULL_EDGE_MARGIN_PX) / radius;
+    double corners[5][2] = {{-half_w, -half_h}, {half_w, -half_h}, {half_w, half_h}, {-half_w, half_h}, {-half_w, -half_h}};
+
+    double min_dot = 1.0;
+    double min_step_dot = 1.0;
+    double prev[3];
+    int have_prev = 0;
+    for (int e = 0; e < 4; e++) {
+        for (int k = 0; k < CULL_EDGE_SAMPLES; k++) {
+            double t = (double)k / CULL_EDGE_SAMPLES;
+            double tx = corners[e][0] + (corners[e + 1][0] - corners[e][0]) * t;
+            double ty = corners[e][1] + (corners[e + 1][1] - corners[e][1]) * t;
+            double p[3];
+            if (!unproject_view_point(view, tx, ty, p)) return 0;
+
+            double dot = c[0]*p[0] + c[1]*p[1] + c[2]*p[2];
+            if (dot < min_dot) min_dot = dot;
+            if (have_prev) {
+                double step = prev[0]*p[0] + prev[1]*p[1] + prev[2]*p[2];
+                if (step < min_step_dot) min_step_dot = step;
+            }
+            prev[0] = p[0]; prev[1] = p[1]; prev[2] = p[2];
+            have_prev = 1;
+        }
+    }
+
+    if (min_dot < -1.0) min_dot = -1.0;
+    if (min_step_dot < -1.0) min_step_dot = -1.0;
+    double cap = (acos(min_dot) + acos(min_step_dot)) * 180.0 / M_PI;
+    if (cap > CULL_MAX_CAP_RADIUS) return 0;
+
+    *cap_alt = asin(c[2] > 1.0 ? 1.0 : c[2]) * 180.0 / M_PI;
+    *cap_az = atan2(c[1], c[0]) * 180.0 / M_PI;
+    if (*cap_az < 0) *cap_az += 360.0;
+    *cap_radius = cap;
+    return 1;
+}
+
+static void draw_text_centered(cairo_t *cr, double x, double y, const char *text) {
+    cairo_text_extents_t extents;
+    cairo_text_extents(cr, text, &extents);
+    cairo_move_to(cr, x - extents.width/2 - extents.x_bearing, y - extents.height/2 - extents.y_bearing);
+    cairo_show_text(cr, text);
+}
+
+// Helper to draw a styled text box (opaque black, white outline)
+static void draw_styled_text_box(const SkyRenderer *r, cairo_t *cr, double x, double y, const char **lines, int count, int right_align) {
+    if (count <= 0) return;
+
+    double font_size = 12.0 * (r->scene->options.font_scale > 0 ? r->scene->options.font_scale : 1.0);
+    cairo_set_font_size(cr, font_size);
+
+    double max_w_left = 0;
+    double max_w_right = 0;
+    double total_h = 0;
+    double line_h = font_size * 1.2;
+    double padding = 5.0;
+    double gap = 10.0;
+
+    // Measure pass
+    for(int i=0; i<count; i++) {
+        const char *sep = strchr(lines[i], '|');
+        if (sep) {
+            char left[64], right[64];
+            int len_l = sep - lines[i];
+            strncpy(left, lines[i], len_l); left[len_l] = '\0';
+            strcpy(right, sep + 1);
+
+            cairo_text_extents_t ext_l, ext_r;
+            cairo_text_extents(cr, left, &ext_l);
+            cairo_text_extents(cr, right, &ext_r);
+            if (ext_l.width > max_w_left) max_w_left = ext_l.width;
+            if (ext_r.width > max_w_right) max_w_right = ext_r.width;
+        } else {
+            cairo_text_extents_t ext;
+            cairo_text_extents(cr, lines[i], &ext);
+            // Treat single lines as covering the full width (contributing to left for simplicity of max_w calc)
+            double w = ext.width;
+            if (w > max_w_left) max_w_left = w; // Provisional, will adjust total max_w later
+        }
+    }
+
+    // If we have split lines, the box width needs to accommodate both columns + gap
+    double box_w = max_w_left + 2 * padding;
+    if (max_w_right > 0) {
+        box_w = max_w_left + gap + max_w_right + 2 * padding;
+    }
+
+    // Re-check single lines against total box width
+    for(int i=0; i<count; i++) {
+        if (!strchr(lines[i], '|')) {
+            cairo_text_extents_t ext;
+            cairo_text_extents(cr, lines[i], &ext);
+            if (ext.width + 2*padding > box_w) box_w = ext.width + 2*padding;
+        }
+    }
+
+    total_h = count * line_h;
+    double box_h = total_h + 2 * padding;
+
+    double draw_x = right_align ? (x - box_w) : x;
+    double draw_y = y;
+
+    // Fill Black
+    cairo_set_source_rgb(cr, 0, 0, 0);
+    cairo_rectangle(cr, draw_x, draw_y, box_w, box_h);
+    cairo_fill_preserve(cr);
+
+    // Stroke White
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_set_line_width(cr, 1.0);
+    cairo_stroke(cr);
+
+    // Draw Text
+    for(int i=0; i<count; i++) {
+        double y_pos = draw_y + padding + (i + 1) * line_h - (line_h - font_size)/2;
+        const char *sep = strchr(lines[i], '|');
+
+        if (sep) {
+            char left[64], right[64];
+            int len_l = sep - lines[i];
+            strncpy(left, lines[i], len_l); left[len_l] = '\0';
+            strcpy(right, sep + 1);
+
+            // Left aligned
+            cairo_move_to(cr, draw_x + padding, y_pos);
+            cairo_show_text(cr, left);
+
+            // Right aligned (at right edge of box - padding)
+            cairo_text_extents_t ext_r;
+            cairo_text_extents(cr, right, &ext_r);
+            cairo_move_to(cr, draw_x + box_w - padding - ext_r.width, y_pos);
+            cairo_show_text(cr, right);
+        } else {
+            cairo_move_to(cr, draw_x + padding, y_pos);
+            cairo_show_text(cr, lines[i]);
+        }
+    }
+}
+
+static void format_time_only(double jd, double timezone, char *buf, size_t len) {
+    if (jd < 0) {
+        snprintf(buf, len, "--:--");
+    } else {
+        DateTime local = datetime_from_julian_day(jd, timezone);
+        snprintf(buf, len, "%02d:%02d", local.hour, local.minute);
+    }
+}
+
+typedef struct {
+    double jd;
+    char label[32];
+    char time_str[16];
+} EphemEvent;
+
+static int compare_ephem_events(const void *a, const void *b) {
+    EphemEvent *ea = (EphemEvent *)a;
+    EphemEvent *eb = (EphemEvent *)b;
+    if (ea->jd < eb->jd) return -1;
+    if (ea->jd > eb->jd) return 1;
+    return 0;
+}
+
+// Projection stage for batch entries [begin, end): projected u/v (cached per
+// projection generation), screen position, size and colour. Runs on the parallel_for pool and only
+// writes its own slice of the scratch buffers.
+static void project_star_chunk(int begin, int end, void *data) {
+    const StarProjection *job = data;
+    SkyRenderer *r = job->r;
+
+    // Only stars not yet projected in this generation go through the
+    // horizontal transform; the rest reuse their cached u/v
+    int *stale = r->star_stale_idx + begin;
+    int num_stale = 0;
+    for (int n = begin; n < end; n++) {
+        int i = job->idx ? job->idx[n] : n;
+        if (r->star_uv_gen[i] != job->generation) stale[num_stale++] = i;
+    }
+    if (num_stale > 0) {
+        double *alt = r->star_batch_alt + begin;
+        double *az = r->star_batch_az + begin;
+        observer_frame_get_horizontal_vectors(job->frame, star_catalog.x, star_catalog.y, star_catalog.z, stale, num_stale, alt, az);
+        for (int k = 0; k < num_stale; k++) {
+            int i = stale[k];
+            r->star_uv_visible[i] = project(r, alt[k], az[k], &r->star_u[i], &r->star_v[i]);
+            r->star_uv_gen[i] = job->generation;
+        }
+    }
+
+    for (int n = begin; n < end; n++) {
+        int i = job->idx ? job->idx[n] : n;
+        StarSprite *sp = &r->star_sprites[n];
+        sp->drawn = r->star_uv_visible[i];
+        if (!sp->drawn) continue;
+
+        double px = r->star_u[i];
+        double py = r->star_v[i];
+        cairo_matrix_transform_point(&job->view, &px, &py);
+        sp->x = px;
+        sp->y = py;
+        sp->on_screen = (px >= 0 && px <= job->width && py >= 0 && py <= job->height);
+
+        int k = star_mag_lut_index(star_catalog.mag[i]);
+        double brightness = job->lut->brightness[k];
+        sp->size = job->lut->size[k];
+
+        if (job->colors) {
+            const double *rgb = job->lut->rgb[star_catalog.color[i]];
+            sp->r = rgb[0] * brightness;
+            sp->g = rgb[1] * brightness;
+            sp->b = rgb[2] * brightness;
+        } else {
+            sp->r = sp->g = sp->b = brightness;
+        }
+        sp->bucket = star_bucket_key(sp->size, sp->r, sp->g, sp->b);
+    }
+}
+
+// Sets the colour of a bucket key and returns its star radius
+static double set_star_bucket_source(cairo_t *cr, unsigned int key) {
+    double red = ((key >> 12) & 63) / (double)(STAR_COLOR_LEVELS - 1);
+    double green = ((key >> 6) & 63) / (double)(STAR_COLOR_LEVELS - 1);
+    double blue = (key & 63) / (double)(STAR_COLOR_LEVELS - 1);
+    cairo_set_source_rgba(cr, red, green, blue, 1.0);
+    return (key >> 18) / STAR_SIZE_STEPS;
+}
+
+// Draws the projected stars, one path and fill per bucket. Returns the number
+// of stars landing on screen.
+static int draw_star_buckets(SkyRenderer *r, cairo_t *cr, int count) {
+    if (!r->star_bucket_table_ready) {
+        for (int k = 0; k < STAR_BUCKET_TABLE_SIZE; k++) r->star_bucket_keys[k] = STAR_BUCKET_EMPTY;
+        r->star_bucket_table_ready = 1;
+    }
+
+    int on_screen = 0;
+    int num_buckets = 0;
+    for (int n = 0; n < count; n++) {
+        const StarSprite *sp = &r->star_sprites[n];
+        if (!sp->drawn) continue;
+        if (sp->on_screen) on_screen++;
+
+        // Open addressing. Extreme size settings can yield more distinct keys
+        // than slots; a star finding the table full is filled on its own.
+        unsigned int slot = (sp->bucket * 2654435761u) >> (32 - STAR_BUCKET_TABLE_BITS);
+        int probes = 0;
+        while (r->star_bucket_keys[slot] != STAR_BUCKET_EMPTY && r->star_bucket_keys[slot] != sp->bucket) {
+            if (++probes == STAR_BUCKET_TABLE_SIZE) break;
+            slot = (slot + 1) & (STAR_BUCKET_TABLE_SIZE - 1);
+        }
+        if (probes == STAR_BUCKET_TABLE_SIZE) {
+            double size = set_star_bucket_source(cr, sp->bucket);
+            cairo_new_path(cr);
+            cairo_arc(cr, sp->x, sp->y, size, 0, 2 * M_PI);
+            cairo_fill(cr);
+            continue;
+        }
+        if (r->star_bucket_keys[slot] == STAR_BUCKET_EMPTY) {
+            r->star_bucket_keys[slot] = sp->bucket;
+            r->star_bucket_head[slot] = n;
+            r->star_bucket_order[num_buckets++] = slot;
+        } else {
+            r->star_bucket_next[r->star_bucket_tail[slot]] = n;
+        }
+        r->star_bucket_tail[slot] = n;
+        r->star_bucket_next[n] = -1;
+    }
+
+    for (int k = 0; k < num_buckets; k++) {
+        int slot = r->star_bucket_order[k];
+        double size = set_star_bucket_source(cr, r->star_bucket_keys[slot]);
+        cairo_new_path(cr);
+        for (int n = r->star_bucket_head[slot]; n >= 0; n = r->star_bucket_next[n]) {
+            cairo_new_sub_path(cr);
+            cairo_arc(cr, r->star_sprites[n].x, r->star_sprites[n].y, size, 0, 2 * M_PI);
+        }
+        cairo_fill(cr);
+
+        r->star_bucket_keys[slot] = STAR_BUCKET_EMPTY; // Leave the table empty for the next frame
+    }
+    return on_screen;
+}
+
+static void update_projection_generation(SkyRenderer *r, const ObserverFrame *frame) {
+    ProjectionKey key;
+    memset(&key, 0, sizeof(key));
+    key.jd = frame->jd;
+    key.lat = frame->loc.lat;
+    key.lon = frame->loc.lon;
+    key.horizon_projection = r->scene->view.horizon_projection;
+    key.horizon_center_az = r->scene->view.horizon_center_az;
+
+    if (r->projection_generation == 0 || memcmp(&key, &r->projection_key, sizeof(key)) != 0) {
+        r->projection_key = key;
+        r->projection_generation++;
+    }
+}
+
+// Curve point at parameter t (degrees) as longitude/latitude (degrees): RA/Dec
+// for equatorial curves, Az/Alt for horizontal ones
+typedef void (*CurvePointFunc)(double t, double param, double *lon, double *lat);
+
+typedef struct {
+    double t, alt, az, u, v;
+    int visible;
+} CurveSample;
+
+typedef struct {
+    const SkyRenderer *r;
+    SkyPolyline *out;
+    const ObserverFrame *frame;
+    CurvePointFunc fn;
+    double param;
+    int equatorial;
+    double tolerance; // u/v units
+    int pen_down;
+} CurveBuilder;
+
+// Circle of constant latitude (Dec or Alt)
+static void parallel_point(double t, double lat, double *out_lon, double *out_lat) {
+    *out_lon = t;
+    *out_lat = lat;
+}
+
+// Half great circle of constant longitude (RA or Az)
+static void meridian_point(double t, double lon, double *out_lon, double *out_lat) {
+    *out_lon = lon;
+    *out_lat = t;
+}
+
+static void ecliptic_point(double t, double jd, double *ra, double *dec) {
+    struct ln_lnlat_posn ecl = {t, 0};
+    struct ln_equ_posn equ;
+    ephemeris_libnova_lock();
+    ln_get_equ_from_ecl(&ecl, jd, &equ);
+    ephemeris_libnova_unlock();
+    *ra = equ.ra;
+    *dec = equ.dec;
+}
+
+static void polyline_clear(SkyPolyline *pl) {
+    pl->count = 0;
+}
+
+static void polyline_push(SkyPolyline *pl, const CurveSample *s, int move) {
+    if (pl->count >= pl->capacity) {
+        int capacity = pl->capacity ? pl->capacity * 2 : 1024;
+        double *alt = realloc(pl->alt, sizeof(double) * capacity);
+        if (alt) pl->alt = alt;
+        double *az = realloc(pl->az, sizeof(double) * capacity);
+        if (az) pl->az = az;
+        double *u = realloc(pl->u, sizeof(double) * capacity);
+        if (u) pl->u = u;
+        double *v = realloc(pl->v, sizeof(double) * capacity);
+        if (v) pl->v = v;
+        unsigned char *mv = realloc(pl->move, capacity);
+        if (mv) pl->move = mv;
+        if (!alt || !az || !u || !v || !mv) return; // Out of memory: drop the vertex
+        pl->capacity = capacity;
+    }
+    pl->alt[pl->count] = s->alt;
+    pl->az[pl->count] = s->az;
+    pl->u[pl->count] = s->u;
+    pl->v[pl->count] = s->v;
+    pl->move[pl->count] = (unsigned char)move;
+    pl->count++;
+}
+
+static void curve_sample(const CurveBuilder *b, double t, CurveSample *s) {
+    double lon, lat;
+    b->fn(t, b->param, &lon, &lat);
+    if (b->equatorial) {
+        observer_frame_get_horizontal(b->frame, lon, lat, &s->alt, &s->az);
+    } else {
+        s->alt = lat;
+        s->az = lon;
+    }
+    s->t = t;
+    s->visible = project(b->r, s->alt, s->az, &s->u, &s->v);
+}
+
+// Appends a sample, starting a new subpath after a gap (below the horizon)
+static void curve_emit(CurveBuilder *b, const CurveSample *s) {
+    if (s->visible) {
+        polyline_push(b->out, s, !b->pen_down);
+        b->pen_down = 1;
+    } else {
+        b->pen_down = 0;
+    }
+}
+
+// Emits the segment (a, c], splitting it while the projected midpoint strays
+// from the chord or the segment crosses or may reach the horizon
+static void curve_subdivide(CurveBuilder *b, const CurveSample *a, const CurveSample *c, int depth) {
+    CurveSample m;
+    curve_sample(b, 0.5 * (a->t + c->t), &m);
+
+    int split = 0;
+    if (depth < CURVE_MAX_DEPTH) {
+        if (a->visible != c->visible || a->visible != m.visible) {
+            split = 1;
+        } else if (m.visible) {
+            double du = m.u - 0.5 * (a->u + c->u);
+            double dv = m.v - 0.5 * (a->v + c->v);
+            split = (du * du + dv * dv > b->tolerance * b->tolerance);
+        } else if (a->alt < 0 && c->alt < 0) {
+            // All three samples below the horizon, but the curve can still
+            // peek over it in between: its altitude changes by at most a
+            // degree per degree of t
+            split = (a->alt + c->alt + (c->t - a->t) > 0);
+        }
+    }
+
+    if (split) {
+        curve_subdivide(b, a, &m, depth + 1);
+        curve_subdivide(b, &m, c, depth + 1);
+    } else {
+        curve_emit(b, c);
+    }
+}
+
+// Appends a curve; frame is NULL for curves already in alt/az
+static void add_curve(const SkyRenderer *r, SkyPolyline *out, const ObserverFrame *frame, CurvePointFunc fn, double param, double t0, double t1, double tolerance) {
+    CurveBuilder b = {r, out, frame, fn, param, frame != NULL, tolerance, 0};
+    int steps = (int)ceil((t1 - t0) / CURVE_INITIAL_STEP);
+    if (steps < 1) steps = 1;
+
+    CurveSample a, c;
+    curve_sample(&b, t0, &a);
+    curve_emit(&b, &a);
+    for (int k = 1; k <= steps; k++) {
+        curve_sample(&b, t0 + (t1 - t0) * k / steps, &c);
+        curve_subdivide(&b, &a, &c, 0);
+        a = c;
+    }
+}
+
+static void update_curve_cache(SkyRenderer *r, const ObserverFrame *frame, double radius, double alt_step, double az_step, double dec_step, double ra_step) {
+    double scale = radius * r->scene->view.zoom;
+    int detail_level = (scale > 1.0) ? (int)floor(log2(scale)) : 0;
+    double tolerance = CURVE_TOLERANCE_PX / ldexp(1.0, detail_level);
+
+    AltAzGridKey grid_key;
+    memset(&grid_key, 0, sizeof(grid_key));
+    grid_key.horizon_projection = r->scene->view.horizon_projection;
+    grid_key.horizon_center_az = r->scene->view.horizon_center_az;
+    grid_key.alt_step = alt_step;
+    grid_key.az_step = az_step;
+    grid_key.detail_level = detail_level;
+
+    if (!r->altaz_grid_valid || memcmp(&grid_key, &r->altaz_grid_key, sizeof(grid_key)) != 0) {
+        polyline_clear(&r->altaz_grid_curves);
+        for (double alt = alt_step; alt < 90; alt += alt_step) {
+            add_curve(r, &r->altaz_grid_curves, NULL, parallel_point, alt, 0.0, 360.0, tolerance);
+        }
+        for (int az = 0; az < 360; az += az_step) {
+            add_curve(r, &r->altaz_grid_curves, NULL, meridian_point, az, 0.0, 90.0, tolerance);
+        }
+        r->altaz_grid_key = grid_key;
+        r->altaz_grid_valid = 1;
+    }
+
+    CurveCacheKey key;
+    memset(&key, 0, sizeof(key));
+    key.generation = r->projection_generation;
+    key.dec_step = dec_step;
+    key.ra_step = ra_step;
+    key.detail_level = detail_level;
+
+    if (r->curve_cache_valid && memcmp(&key, &r->curve_cache_key, sizeof(key)) == 0) return;
+
+    polyline_clear(&r->radec_grid_curves);
+    for (double dec = -80; dec <= 80; dec += dec_step) {
+        add_curve(r, &r->radec_grid_curves, frame, parallel_point, dec, 0.0, 360.0, tolerance);
+    }
+    for (double ra_h = 0; ra_h < 24; ra_h += ra_step) {
+        add_curve(r, &r->radec_grid_curves, frame, meridian_point, ra_h * 15.0, -90.0, 90.0, tolerance);
+    }
+
+    polyline_clear(&r->ecliptic_curve);
+    add_curve(r, &r->ecliptic_curve, frame, ecliptic_point, frame->jd, 0.0, 360.0, tolerance);
+
+    r->curve_cache_key = key;
+    r->curve_cache_valid = 1;
+}
+
+static void update_constellation_cache(SkyRenderer *r, const ObserverFrame *frame) {
+    if (r->constellation_generation == r->projection_generation && r->constellation_geometry_count == num_constellations) return;
+
+    const ConstellationVertices *cv = &constellation_vertices;
+    if (r->constellation_geometry_count != num_constellations) {
+        free(r->constellation_geometry);
+        r->constellation_geometry = calloc(num_constellations > 0 ? num_constellations : 1, sizeof(ConstellationGeometry));
+        r->constellation_geometry_count = r->constellation_geometry ? num_constellations : 0;
+    }
+    if (r->constellation_scratch_capacity < cv->num_vertices) {
+        free(r->constellation_alt); free(r->constellation_az);
+        r->constellation_alt = malloc(sizeof(double) * cv->num_vertices);
+        r->constellation_az = malloc(sizeof(double) * cv->num_vertices);
+        r->constellation_scratch_capacity = (r->constellation_alt && r->constellation_az) ? cv->num_vertices : 0;
+        if (!r->constellation_scratch_capacity) r->constellation_geometry_count = 0;
+    }
+
+    polyline_clear(&r->constellation_curves);
+    for (int i = 0; i < r->constellation_geometry_count; i++) {
+        const Constellation *c = &constellations[i];
+        ConstellationGeometry *geo = &r->constellation_geometry[i];
+        geo->first = geo->end = r->constellation_curves.count;
+        geo->label_visible = 0;
+
+        double center_alt, center_az;
+        observer_frame_get_horizontal_vectors(frame, &c->center[0], &c->center[1], &c->center[2], NULL, 1, &center_alt, &center_az);
+        if (center_alt + c->cap_radius < 0) continue; // Wholly below the horizon
+        geo->label_visible = project(r, center_alt, center_az, &geo->label_u, &geo->label_v);
+
+        int first_vertex = cv->line_start[c->first_line];
+        int num_vertices = cv->line_start[c->first_line + c->num_lines] - first_vertex;
+        double *alt = r->constellation_alt + first_vertex;
+        double *az = r->constellation_az + first_vertex;
+        observer_frame_get_horizontal_vectors(frame, cv->x + first_vertex, cv->y + first_vertex, cv->z + first_vertex, NULL, num_vertices, alt, az);
+
+        for (int j = c->first_line; j < c->first_line + c->num_lines; j++) {
+            int first = 1;
+            for (int v = cv->line_start[j]; v < cv->line_start[j + 1]; v++) {
+                CurveSample p;
+                p.alt = r->constellation_alt[v];
+                p.az = r->constellation_az[v];
+                if (project(r, p.alt, p.az, &p.u, &p.v)) {
+                    polyline_push(&r->constellation_curves, &p, first);
+                    first = 0;
+                } else first = 1;
+            }
+        }
+        geo->end = r->constellation_curves.count;
+    }
+    r->constellation_generation = r->projection_generation;
+}
+
+// Adds vertices [first, end) of a u/v polyline to the current path
+static void append_polyline(cairo_t *cr, const SkyPolyline *pl, int first, int end) {
+    for (int n = first; n < end; n++) {
+        if (pl->move[n] || n == first) cairo_move_to(cr, pl->u[n], pl->v[n]);
+        else cairo_line_to(cr, pl->u[n], pl->v[n]);
+    }
+}
+
+// Strokes a u/v polyline through the view matrix. The path is built under the
+// matrix and stroked without it, so the line width stays in layer pixels.
+static void draw_polyline(cairo_t *cr, const SkyPolyline *pl, const cairo_matrix_t *view) {
+    cairo_new_path(cr);
+    cairo_save(cr);
+    cairo_transform(cr, view);
+    append_polyline(cr, pl, 0, pl->count);
+    cairo_restore(cr);
+    cairo_stroke(cr);
+}
+
+// Everything except the cursor and hover overlays
+static void draw_sky_layer(SkyRenderer *r, cairo_t *cr, int width, int height) {
+    double radius = (width < height ? width : height) / 2.0 - 10;
+    double cx = width / 2.0;
+    double cy = height / 2.0;
+
+    // Site/time setup shared by every object drawn in this frame. Time steps
+    // (arrows, elevation plot scrubbing) reuse the previous sidereal solve.
+    if (r->layer_frame_valid) {
+        observer_frame_advance(&r->layer_frame, r->scene->loc, r->scene->dt);
+    } else {
+        observer_frame_init(&r->layer_frame, r->scene->loc, r->scene->dt);
+        r->layer_frame_valid = 1;
+    }
+    ObserverFrame frame = r->layer_frame;
+
+    double effective_limit = r->scene->options.star_mag_limit;
+    double effective_m0 = r->scene->options.star_size_m0;
+    double effective_ma = r->scene->options.star_size_ma;
+
+    if (r->scene->options.auto_star_settings) {
+        effective_limit = 8.0 + r->scene->view.zoom;
+        effective_m0 = 5.5 + 0.3 * sqrt(r->scene->view.zoom);
+        effective_ma = 0.35 + 0.05 * sqrt(r->scene->view.zoom);
+    }
+
+    cairo_set_source_rgb(cr, 0, 0, 0);
+    cairo_paint(cr);
+
+    double h_cx = cx + r->scene->view.pan_x * radius;
+    double h_cy = cy + r->scene->view.pan_y * radius;
+    double h_r = radius * r->scene->view.zoom;
+
+    cairo_set_source_rgb(cr, 0, 0, 0.1);
+    cairo_arc(cr, h_cx, h_cy, h_r, 0, 2 * M_PI);
+    cairo_fill_preserve(cr);
+
+    cairo_save(cr);
+    cairo_clip(cr);
+
+    // Grids
+    double alt_step = 10;
+    double az_step = 45;
+    if (r->scene->view.zoom > 2.0) { alt_step = 5; az_step = 15; }
+    if (r->scene->view.zoom > 5.0) { alt_step = 2; az_step = 5; }
+    if (r->scene->view.zoom > 15.0) { alt_step = 1; az_step = 1; }
+
+    double dec_step = 20;
+    double ra_step = 2; // hours
+    if (r->scene->view.zoom > 2.0) { dec_step = 10; ra_step = 1; }
+    if (r->scene->view.zoom > 5.0) { dec_step = 5; ra_step = 0.5; } // 30 min
+    if (r->scene->view.zoom > 15.0) { dec_step = 1; ra_step = 0.1666; } // 10 min
+
+    // Cached u/v geometry is reused across pan/zoom/rotation; only the view
+    // matrix changes
+    update_projection_generation(r, &frame);
+    cairo_matrix_t view;
+    view_matrix(&r->scene->view, &view, cx, cy, radius);
+
+    // Zoomed in: a spherical cap (equatorial centre, radius in degrees) around
+    // the viewport lets stars and constellations out of view be skipped
+    int view_cap_valid = 0;
+    double view_cap_ra = 0, view_cap_dec = 0, view_cap_radius = 0;
+    double cap_alt, cap_az;
+    if (r->scene->view.zoom > CULL_MIN_ZOOM && viewport_cap(&r->scene->view, width, height, radius, &cap_alt, &cap_az, &view_cap_radius)) {
+        observer_frame_get_equatorial(&frame, cap_alt, cap_az, &view_cap_ra, &view_cap_dec);
+        view_cap_valid = 1;
+    }
+
+    if (r->scene->options.show_alt_az_grid || r->scene->options.show_ra_dec_grid || r->scene->options.show_ecliptic) {
+        update_curve_cache(r, &frame, radius, alt_step, az_step, dec_step, ra_step);
+    }
+
+    if (r->scene->options.show_alt_az_grid) {
+        cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.8);
+        cairo_set_line_width(cr, 1.0);
+        draw_polyline(cr, &r->altaz_grid_curves, &view);
+
+        // Altitude labels: multiples of the step when it is 10 deg or more, else of 10
+        for (double alt = alt_step; alt < 90; alt += alt_step) {
+            int label_it = 0;
+            if (alt_step >= 10 && (int)alt % (int)alt_step == 0) label_it = 1;
+            else if ((int)alt % 10 == 0) label_it = 1;
+
+            if (label_it) {
+                char buf[10]; sprintf(buf, "%d", (int)alt);
+                double u, v;
+                if (project(r, alt, 180, &u, &v)) {
+                    double tx, ty; transform_point(r, u, v, &tx, &ty);
+                    cairo_move_to(cr, cx + tx * radius, cy + ty * radius);
+                    cairo_show_text(cr, buf);
+                }
+            }
+        }
+    }
+
+    if (r->scene->options.show_ra_dec_grid) {
+        cairo_set_source_rgba(cr, 0.3, 0.3, 0.8, 0.8);
+        cairo_set_line_width(cr, 1.0);
+        draw_polyline(cr, &r->radec_grid_curves, &view);
+    }
+
+    if (r->scene->options.show_ecliptic) {
+        cairo_set_source_rgba(cr, 1.0, 1.0, 0.0, 0.8);
+        cairo_set_line_width(cr, 2.0);
+        draw_polyline(cr, &r->ecliptic_curve, &view);
+    }
+
+    if (r->scene->options.show_constellation_lines) {
+        update_constellation_cache(r, &frame);
+
+        // Figures whose cap misses the viewport cap are left out
+        double view_dir[3] = {0, 0, 0};
+        if (view_cap_valid) {
+            double ra_rad = view_cap_ra * M_PI / 180.0;
+            double dec_rad = view_cap_dec * M_PI / 180.0;
+            view_dir[0] = cos(dec_rad) * cos(ra_rad);
+            view_dir[1] = cos(dec_rad) * sin(ra_rad);
+            view_dir[2] = sin(dec_rad);
+        }
+        for (int i = 0; i < r->constellation_geometry_count; i++) {
+            const Constellation *c = &constellations[i];
+            int in_view = 1;
+            if (view_cap_valid) {
+                double dot = view_dir[0] * c->center[0] + view_dir[1] * c->center[1] + view_dir[2] * c->center[2];
+                if (dot > 1.0) dot = 1.0;
+                if (dot < -1.0) dot = -1.0;
+                in_view = (acos(dot) * 180.0 / M_PI <= c->cap_radius + view_cap_radius);
+            }
+            r->constellation_geometry[i].in_view = in_view;
+        }
+
+        cairo_set_source_rgba(cr, 0.5, 0.5, 0.8, 0.5);
+        cairo_set_line_width(cr, 1.0);
+        cairo_new_path(cr);
+        cairo_save(cr);
+        cairo_transform(cr, &view);
+        for (int i = 0; i < r->constellation_geometry_count; i++) {
+            if (!r->constellation_geometry[i].in_view) continue;
+            append_polyline(cr, &r->constellation_curves, r->constellation_geometry[i].first, r->constellation_geometry[i].end);
+        }
+        cairo_restore(cr);
+        cairo_stroke(cr);
+
+        if (r->scene->options.show_constellation_names) {
+            cairo_set_source_rgba(cr, 0.8, 0.8, 1.0, 0.7);
+            for (int i = 0; i < r->constellation_geometry_count; i++) {
+                const ConstellationGeometry *geo = &r->constellation_geometry[i];
+                if (!geo->in_view || !geo->label_visible) continue;
+                double x = geo->label_u, y = geo->label_v;
+                cairo_matrix_transform_point(&view, &x, &y);
+                draw_text_centered(cr, x, y, constellations[i].id);
+            }
+        }
+    }
+
+    int stars_total_brighter = 0;
+    int stars_visible_in_view = 0;
+
+    if (num_stars > 0) {
+        if (r->star_batch_capacity < num_stars) {
+            free(r->star_batch_idx); free(r->star_batch_alt); free(r->star_batch_az); free(r->star_sprites); free(r->star_bucket_next);
+            free(r->star_stale_idx); free(r->star_u); free(r->star_v); free(r->star_uv_visible); free(r->star_uv_gen);
+            r->star_batch_idx = malloc(sizeof(int) * num_stars);
+            r->star_batch_alt = malloc(sizeof(double) * num_stars);
+            r->star_batch_az = malloc(sizeof(double) * num_stars);
+            r->star_sprites = malloc(sizeof(StarSprite) * num_stars);
+            r->star_bucket_next = malloc(sizeof(int) * num_stars);
+            r->star_stale_idx = malloc(sizeof(int) * num_stars);
+            r->star_u = malloc(sizeof(double) * num_stars);
+            r->star_v = malloc(sizeof(double) * num_stars);
+            r->star_uv_visible = malloc(num_stars);
+            r->star_uv_gen = calloc(num_stars, sizeof(unsigned int)); // 0: never projected
+            r->star_batch_capacity = num_stars;
+        }
+
+        // The catalog is sorted by magnitude, so the stars passing the cut are a
+        // prefix of it
+        stars_total_brighter = catalog_count_brighter(effective_limit);
+
+        // Zoomed in: only visit the index cells under the viewport
+        const int *batch_idx = NULL;
+        int batch_count = stars_total_brighter;
+        if (view_cap_valid) {
+            int num_cells = star_index_query_cells(view_cap_ra, view_cap_dec, view_cap_radius, r->cull_cells, STAR_INDEX_NPIX);
+            if (num_cells > STAR_INDEX_NPIX) num_cells = STAR_INDEX_NPIX;
+
+            batch_count = 0;
+            for (int k = 0; k < num_cells; k++) {
+                int n;
+                const int *list = star_index_cell_stars(r->cull_cells[k], &n);
+                for (int m = 0; m < n && list[m] < stars_total_brighter; m++) {
+                    r->star_batch_idx[batch_count++] = list[m];
+                }
+            }
+            batch_idx = r->star_batch_idx;
+        }
+
+        // Project on the worker pool, then issue the draw calls here
+        star_color_table_update(&r->star_colors, effective_m0, effective_ma, r->scene->options.star_saturation);
+        StarProjection job = {
+            r, &frame, r->projection_generation, batch_idx, view, width, height,
+            &r->star_colors, r->scene->options.show_star_colors
+        };
+        parallel_for(batch_count, STAR_PROJECTION_MIN_CHUNK, project_star_chunk, &job);
+
+        stars_visible_in_view = draw_star_buckets(r, cr, batch_count);
+    }
+
+    if (r->scene->options.show_planets) {
+        PlanetID p_ids[] = {PLANET_MERCURY, PLANET_VENUS, PLANET_MARS, PLANET_JUPITER, PLANET_SATURN, PLANET_URANUS, PLANET_NEPTUNE};
+        const char *p_names[] = {"Mercury", "Venus", "Mars", "Jupiter", "Saturn", "Uranus", "Neptune"};
+        for (int p=0; p<7; p++) {
+            double alt, az, ra, dec, u, v, tx, ty;
+            observer_frame_get_planet_position(&frame, p_ids[p], &alt, &az, &ra, &dec);
+            if (project(r, alt, az, &u, &v)) {
+                transform_point(r, u, v, &tx, &ty);
+                cairo_set_source_rgb(cr, 1.0, 0.5, 0.5);
+                cairo_arc(cr, cx + tx * radius, cy + ty * radius, 3, 0, 2 * M_PI);
+                cairo_fill(cr);
+                cairo_move_to(cr, cx + tx * radius + 4, cy + ty * radius);
+                cairo_show_text(cr, p_names[p]);
+            }
+        }
+    }
+
+    int num_lists = target_list_get_list_count();
+    for (int l = 0; l < num_lists; l++) {
+        TargetList *tl = target_list_get_list_by_index(l);
+        if (!target_list_is_visible(tl)) continue;
+
+        int cnt = target_list_get_count(tl);
+        for (int i=0; i<cnt; i++) {
+            Target *tgt = target_list_get_target(tl, i);
+            double alt, az, u, v, tx, ty;
+            observer_frame_get_horizontal(&frame, tgt->ra, tgt->dec, &alt, &az);
+            if (project(r, alt, az, &u, &v)) {
+                transform_point(r, u, v, &tx, &ty);
+
+                if (tgt == r->scene->highlighted) {
+                    cairo_set_source_rgb(cr, 0.0, 1.0, 1.0); cairo_set_line_width(cr, 3.0);
+                } else {
+                    cairo_set_source_rgb(cr, 1.0, 0.3, 0.3); cairo_set_line_width(cr, 1.5);
+                }
+
+                cairo_new_path(cr);
+                cairo_arc(cr, cx + tx * radius, cy + ty * radius, 6, 0, 2 * M_PI);
+                cairo_stroke(cr);
+                cairo_set_line_width(cr, 1.0);
+                cairo_move_to(cr, cx + tx * radius + 8, cy + ty * radius);
+                cairo_show_text(cr, tgt->name);
+            }
+        }
+    }
+
+    if (r->scene->highlighted) {
+        // Calculate Sunset/Sunrise for trajectory limits
+        DateTime noon_dt = r->scene->dt;
+        noon_dt.hour = 12; noon_dt.minute = 0; noon_dt.second = 0;
+        double jd_noon = get_julian_day(noon_dt);
+
+        struct ln_rst_time rst;
+        double horizon = -0.833; // Approx geometrical horizon
+        ephemeris_get_rst(EPHEMERIS_SUN, r->scene->loc, jd_noon, horizon, &rst);
+
+        // Determine start (Sunset) and end (Sunrise next day)
+        double jd_start = (rst.set > 0) ? rst.set : jd_noon - 0.25; // Default if no set
+        double jd_end = (rst.rise > 0) ? rst.rise : jd_noon + 0.75; // Default if no rise
+
+        // If rise is before set (e.g., rise 6:00, set 18:00), we want the night *after* this sunset.
+        // So rise should be the *next* rise.
+        if (jd_end < jd_start) {
+             ephemeris_get_rst(EPHEMERIS_SUN, r->scene->loc, jd_noon + 1.0, horizon, &rst);
+             jd_end = (rst.rise > 0) ? rst.rise : jd_end + 1.0;
+        }
+
+        // Clip to +/- 12 hours from now to keep it sane
+        double current_jd = frame.jd;
+        if (jd_start < current_jd - 0.5) jd_start = current_jd - 0.5;
+        if (jd_end > current_jd + 0.5) jd_end = current_jd + 0.5;
+
+        // Ensure start < end
+        if (jd_start >= jd_end) {
+             jd_start = current_jd - 0.25;
+             jd_end = current_jd + 0.25;
+        }
+
+        cairo_set_line_width(cr, 3.0);
+
+        double step_hours = 0.1;
+        double t_start = (jd_start - current_jd) * 24.0;
+        double t_end = (jd_end - current_jd) * 24.0;
+
+        int first_pt = 1;
+
+        // Draw path
+        for (double t = t_start; t <= t_end; t += step_hours) {
+            double jd_step = current_jd + t / 24.0;
+
+            ObserverFrame step_frame = frame;
+            observer_frame_advance_jd(&step_frame, r->scene->loc, jd_step);
+
+            // Check Sun Alt for Color
+            double sun_alt, sun_az;
+            observer_frame_get_sun_position(&step_frame, &sun_alt, &sun_az);
+
+            if (sun_alt > -18.0) {
+                 cairo_set_source_rgba(cr, 1.0, 0.3, 0.3, 0.8); // Red (Twilight/Day)
+            } else {
+                 cairo_set_source_rgba(cr, 0.6, 0.6, 0.6, 0.8); // Grey (Night)
+            }
+
+            double alt, az;
+            observer_frame_get_horizontal(&step_frame, r->scene->highlighted->ra, r->scene->highlighted->dec, &alt, &az);
+
+            double u, v, tx, ty;
+            if (project(r, alt, az, &u, &v)) {
+                transform_point(r, u, v, &tx, &ty);
+                if (first_pt) {
+                    cairo_move_to(cr, cx + tx * radius, cy + ty * radius);
+                    first_pt = 0;
+                } else {
+                    cairo_line_to(cr, cx + tx * radius, cy + ty * radius);
+                    cairo_stroke(cr); // Stroke segment to allow color change
+                    cairo_move_to(cr, cx + tx * radius, cy + ty * radius);
+                }
+            } else {
+                first_pt = 1;
+            }
+        }
+        cairo_stroke(cr); // Final stroke
+
+        // Draw markers
+        cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+        cairo_set_line_width(cr, 1.0);
+
+        cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+        double old_font_size = 12.0 * (r->scene->options.font_scale > 0 ? r->scene->options.font_scale : 1.0);
+        cairo_set_font_size(cr, old_font_size * 1.3); // Larger labels
+
+        for (int h = (int)ceil(t_start); h <= (int)floor(t_end); h++) {
+            double jd_step = current_jd + h / 24.0;
+            ObserverFrame step_frame = frame;
+            observer_frame_advance_jd(&step_frame, r->scene->loc, jd_step);
+
+            double alt, az;
+            observer_frame_get_horizontal(&step_frame, r->scene->highlighted->ra, r->scene->highlighted->dec, &alt, &az);
+
+            double u, v, tx, ty;
+            if (project(r, alt, az, &u, &v)) {
+                transform_point(r, u, v, &tx, &ty);
+                cairo_arc(cr, cx + tx * radius, cy + ty * radius, 3, 0, 2*M_PI);
+                cairo_fill(cr);
+
+                char label[16];
+                if (h == 0) snprintf(label, 16, "Now");
+                else snprintf(label, 16, "%+dh", h);
+                cairo_move_to(cr, cx + tx * radius + 5, cy + ty * radius - 5);
+                cairo_show_text(cr, label);
+            }
+        }
+    }
+
+    double s_alt, s_az, u, v, tx, ty;
+    observer_frame_get_sun_position(&frame, &s_alt, &s_az);
+    if (project(r, s_alt, s_az, &u, &v)) {
+        transform_point(r, u, v, &tx, &ty);
+        cairo_set_source_rgb(cr, 1, 1, 0);
+        cairo_arc(cr, cx + tx * radius, cy + ty * radius, 5, 0, 2 * M_PI);
+        cairo_fill(cr);
+        cairo_move_to(cr, cx + tx * radius + 6, cy + ty * radius);
+        cairo_show_text(cr, "Sun");
+    }
+
+    double m_alt, m_az, m_ra, m_dec;
+    observer_frame_get_moon_position(&frame, &m_alt, &m_az);
+    get_moon_equ_coords(r->scene->dt, &m_ra, &m_dec);
+    if (project(r, m_alt, m_az, &u, &v)) {
+        transform_point(r, u, v, &tx, &ty);
+        cairo_set_source_rgb(cr, 0.8, 0.8, 0.8);
+        cairo_arc(cr, cx + tx * radius, cy + ty * radius, 4, 0, 2 * M_PI);
+        cairo_fill(cr);
+        cairo_move_to(cr, cx + tx * radius + 6, cy + ty * radius);
+        cairo_set_source_rgb(cr, 1, 1, 1);
+        cairo_show_text(cr, "Moon");
+        if (r->scene->options.show_moon_circles) {
+            cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 0.3);
+            cairo_set_line_width(cr, 1.0);
+            for (int r_deg = 5; r_deg <= 20; r_deg += 5) {
+                int first_pt = 1;
+                for (int ang = 0; ang <= 360; ang += 10) {
+                    double theta = ang * M_PI / 180.0; double delta = r_deg * M_PI / 180.0;
+                    double alt0 = m_alt * M_PI / 180.0; double az0 = m_az * M_PI / 180.0;
+                    double sin_alt1 = sin(alt0)*cos(delta) + cos(alt0)*sin(delta)*cos(theta);
+                    double alt1 = asin(sin_alt1);
+                    double y_val = sin(delta)*sin(theta);
+                    double x_val = cos(delta)*cos(alt0) - sin(alt0)*sin(delta)*cos(theta);
+                    double az1 = az0 + atan2(y_val, x_val);
+                    double alt_deg = alt1 * 180.0 / M_PI; double az_deg = az1 * 180.0 / M_PI;
+                    double u2, v2, tx2, ty2;
+                    if (project(r, alt_deg, az_deg, &u2, &v2)) {
+                        transform_point(r, u2, v2, &tx2, &ty2);
+                        if (first_pt) { cairo_move_to(cr, cx + tx2 * radius, cy + ty2 * radius); first_pt = 0; }
+                        else { cairo_line_to(cr, cx + tx2 * radius, cy + ty2 * radius); }
+                    } else first_pt = 1;
+                }
+                cairo_stroke(cr);
+            }
+        }
+    }
+
+    {
+        double u, v; project(r, 90, 0, &u, &v); double tx, ty; transform_point(r, u, v, &tx, &ty);
+        cairo_set_source_rgb(cr, 1, 1, 0); cairo_arc(cr, cx + tx * radius, cy + ty * radius, 3, 0, 2 * M_PI); cairo_fill(cr);
+    }
+
+    cairo_restore(cr);
+    cairo_set_source_rgb(cr, 0.2, 0.2, 0.2); cairo_arc(cr, h_cx, h_cy, h_r, 0, 2 * M_PI); cairo_stroke(cr);
+
+    // Directions (Moved to front layer to prevent clipping by horizon)
+    {
+        cairo_save(cr);
+        // Clip to drawing area? Or just draw?
+        // If we draw outside the circle in Zenith mode, it might look weird.
+        // But user asked to be "entirely visible" and not cropped by horizon.
+        // Horizon in Zenith mode is the circle edge.
+        // So we should NOT clip to the circle if we want them fully visible outside.
+        // But we should respect widget bounds.
+
+        // Directions (N=180, S=0)
+        struct { char *label; double az; } dirs[] = {
+            {"N", 180}, {"NE", 225}, {"E", 270}, {"SE", 315},
+            {"S", 0}, {"SW", 45}, {"W", 90}, {"NW", 135}
+        };
+
+        // Brighter, Bolder, Bigger for directions
+        cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+        double dir_font_size = 15.0 * (r->scene->options.font_scale > 0 ? r->scene->options.font_scale : 1.0);
+        cairo_set_font_size(cr, dir_font_size);
+        cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+
+        for (int i=0; i<8; i++) {
+            double u, v;
+            // Use raw azimuth to match star projection (South=0 at Top)
+            double draw_az = dirs[i].az;
+
+            if (project(r, 0, draw_az, &u, &v)) {
+                double tx, ty;
+                transform_point(r, u, v, &tx, &ty);
+                draw_text_centered(cr, cx + tx * radius, cy + ty * radius, dirs[i].label);
+            }
+        }
+        cairo_restore(cr);
+    }
+
+    // Info Boxes
+    {
+        double lst = frame.lst;
+        double jd_ut = frame.jd; struct ln_date ut_date; ln_get_date(jd_ut, &ut_date);
+        double mjd = jd_ut - 2400000.5;
+
+        char buf_loc[64], buf_ut[64], buf_lst[64], buf_mjd[64];
+        char buf_lat[64], buf_lon[64], buf_elev[64];
+
+        snprintf(buf_loc, 64, "Local|%04d-%02d-%02d %02d:%02d:%02d", r->scene->dt.year, r->scene->dt.month, r->scene->dt.day, r->scene->dt.hour, r->scene->dt.minute, (int)r->scene->dt.second);
+        snprintf(buf_ut, 64, "UT|%04d-%02d-%02d %02d:%02d:%02d", ut_date.years, ut_date.months, ut_date.days, ut_date.hours, ut_date.minutes, (int)ut_date.seconds);
+        snprintf(buf_lst, 64, "LST|%02d:%02d", (int)lst, (int)((lst - (int)lst)*60));
+        snprintf(buf_mjd, 64, "MJD|%.5f", mjd);
+
+        snprintf(buf_lat, 64, "Lat|%.4f", r->scene->loc.lat);
+        snprintf(buf_lon, 64, "Lon|%.4f", r->scene->loc.lon);
+        snprintf(buf_elev, 64, "Elev|%.0fm", r->scene->loc.elevation);
+
+        const char *lines[] = {buf_loc, buf_ut, buf_lst, buf_mjd, buf_lat, buf_lon, buf_elev};
+        draw_styled_text_box(r, cr, 10, 10, lines, 7, 0);
+    }
+
+    // Ephemeris Box
+    {
+        // Use Noon JD to ensure we get events for the "current local day" (Morning Rise, Evening Set)
+        DateTime noon_dt = r->scene->dt;
+        noon_dt.hour = 12; noon_dt.minute = 0; noon_dt.second = 0;
+        double jd_noon = get_julian_day(noon_dt);
+
+        // Original JD for phase calculation (current time)
+        double jd_now = frame.jd;
+
+        struct ln_rst_time rst;
+
+        // Elevation correction for horizon (Dip + Refraction adjustment)
+        double R = 6378140.0; // Earth Radius in meters
+        double h = r->scene->loc.elevation;
+
+        // 1. Horizon Dip
+        double dip = 0.0;
+        if (h > 0) {
+            dip = acos(R / (R + h)) * (180.0 / M_PI);
+        }
+
+        // 2. Atmospheric Refraction scaling with Altitude
+        // Standard Atmosphere Model
+        double T_std = 15.0; // Sea level temp (C)
+        double P_std = 1013.25; // Sea level pressure (mbar)
+
+        // Temperature at altitude (Lapse rate 6.5 K/km)
+        double T_alt = T_std - 0.0065 * h;
+        if (T_alt < -273.15) T_alt = -273.15; // Limit absolute zero
+
+        // Pressure at altitude (Troposphere formula)
+        double P_alt = P_std * pow(1.0 - 2.25577e-5 * h, 5.25588);
+        if (P_alt < 0) P_alt = 0;
+
+        // Scale standard refraction (0.5667 deg ~ 34 arcmin)
+        double ref_scale = (P_alt / P_std) * (288.15 / (273.15 + T_alt));
+        double refraction = 0.5667 * ref_scale;
+
+        double semidiameter = 0.2666; // ~16 arcmin
+
+        double horizon = -(semidiameter + refraction + dip);
+
+        char buf_header[64];
+
+        // Timezone: 0 for UT, the scene's timezone_offset for Local
+        double tz = r->scene->options.ephemeris_use_ut ? 0.0 : r->scene->dt.timezone_offset;
+
+        if (r->scene->options.ephemeris_use_ut) {
+            snprintf(buf_header, 64, "Ephemeris (UT)");
+        } else {
+            snprintf(buf_header, 64, "Ephemeris (Local UTC%+.1f)", tz);
+        }
+
+        EphemEvent events[10];
+        int ev_count = 0;
+
+        // Solar
+        ephemeris_get_rst(EPHEMERIS_SUN, r->scene->loc, jd_noon, horizon, &rst);
+        double sun_set_today = (rst.set > 0) ? rst.set : -1.0;
+
+        // Sunset (rst.set)
+        events[ev_count].jd = (rst.set > 0) ? rst.set : 999999999.0;
+        strcpy(events[ev_count].label, "Sunset");
+        format_time_only((rst.set > 0) ? rst.set : -1, tz, events[ev_count].time_str, 16);
+        ev_count++;
+
+        // Sunrise (rst.rise)
+        events[ev_count].jd = (rst.rise > 0) ? rst.rise : 999999999.0;
+        strcpy(events[ev_count].label, "Sunrise");
+        format_time_only((rst.rise > 0) ? rst.rise : -1, tz, events[ev_count].time_str, 16);
+        ev_count++;
+
+        // Night Mid (Sun) calculation
+        // Need next day's sunrise
+        struct ln_rst_time rst_next;
+        ephemeris_get_rst(EPHEMERIS_SUN, r->scene->loc, jd_noon + 1.0, horizon, &rst_next);
+        double sun_rise_tomorrow = (rst_next.rise > 0) ? rst_next.rise : -1.0;
+
+        if (sun_set_today > 0 && sun_rise_tomorrow > 0) {
+            double mid_sun = (sun_set_today + sun_rise_tomorrow) / 2.0;
+            events[ev_count].jd = mid_sun;
+            strcpy(events[ev_count].label, "Night Mid (Sun)");
+            format_time_only(mid_sun, tz, events[ev_count].time_str, 16);
+            ev_count++;
+        }
+
+        ephemeris_get_rst(EPHEMERIS_SUN, r->scene->loc, jd_noon, -18.0, &rst);
+        double twi_end_today = (rst.set > 0) ? rst.set : -1.0;
+
+        // Astro Tw. Start (rst.rise)
+        events[ev_count].jd = (rst.rise > 0) ? rst.rise : 999999999.0;
+        strcpy(events[ev_count].label, "Astro Tw. Start");
+        format_time_only((rst.rise > 0) ? rst.rise : -1, tz, events[ev_count].time_str, 16);
+        ev_count++;
+
+        // Astro Tw. End (rst.set)
+        events[ev_count].jd = (rst.set > 0) ? rst.set : 999999999.0;
+        strcpy(events[ev_count].label, "Astro Tw. End");
+        format_time_only((rst.set > 0) ? rst.set : -1, tz, events[ev_count].time_str, 16);
+        ev_count++;
+
+        // Night Mid (Twil) calculation
+        ephemeris_get_rst(EPHEMERIS_SUN, r->scene->loc, jd_noon + 1.0, -18.0, &rst_next);
+        double twi_start_tomorrow = (rst_next.rise > 0) ? rst_next.rise : -1.0;
+
+        if (twi_end_today > 0 && twi_start_tomorrow > 0) {
+            double mid_twi = (twi_end_today + twi_start_tomorrow) / 2.0;
+            events[ev_count].jd = mid_twi;
+            strcpy(events[ev_count].label, "Night Mid (Twil)");
+            format_time_only(mid_twi, tz, events[ev_count].time_str, 16);
+            ev_count++;
+        }
+
+        // Lunar
+        ephemeris_get_rst(EPHEMERIS_MOON, r->scene->loc, jd_noon, 0.0, &rst);
+
+        // Moon Rise (rst.rise)
+        events[ev_count].jd = (rst.rise > 0) ? rst.rise : 999999999.0;
+        strcpy(events[ev_count].label, "Moon Rise");
+        format_time_only((rst.rise > 0) ? rst.rise : -1, tz, events[ev_count].time_str, 16);
+        ev_count++;
+
+        // Moon Set (rst.set)
+        events[ev_count].jd = (rst.set > 0) ? rst.set : 999999999.0;
+        strcpy(events[ev_count].label, "Moon Set");
+        format_time_only((rst.set > 0) ? rst.set : -1, tz, events[ev_count].time_str, 16);
+        ev_count++;
+
+        qsort(events, ev_count, sizeof(EphemEvent), compare_ephem_events);
+
+        char lines_buf[12][64];
+        const char *lines_ptr[12];
+
+        lines_ptr[0] = buf_header;
+
+        for(int i=0; i<ev_count; i++) {
+            snprintf(lines_buf[i], 64, "%s|%s", events[i].label, events[i].time_str);
+            lines_ptr[i+1] = lines_buf[i];
+        }
+
+        ephemeris_libnova_lock();
+        double phase = ln_get_lunar_disk(jd_now); // 0..1
+        ephemeris_libnova_unlock();
+        char buf_mill[64];
+        snprintf(buf_mill, 64, "Moon Illum|%.1f%%", phase * 100.0);
+        lines_ptr[ev_count+1] = buf_mill;
+
+        double scale = (r->scene->options.font_scale > 0 ? r->scene->options.font_scale : 1.0);
+        double y_offset = 10 + (12.0 * scale * 1.2 * 6 + 10) + 10;
+
+        draw_styled_text_box(r, cr, 10, y_offset, lines_ptr, ev_count + 2, 0);
+    }
+
+    // Star Count Box (After Restore)
+    {
+        char count_buf[64];
+        snprintf(count_buf, 64, "Stars: %d / %d", stars_visible_in_view, stars_total_brighter);
+        const char *lines[] = {count_buf};
+        draw_styled_text_box(r, cr, 10, height - 10 - 30, lines, 1, 0); // Simplified position logic
+    }
+
+    // Zoom and FOV Info (Bottom Right)
+    {
+        double fov = 180.0 / r->scene->view.zoom;
+        char info_buf[64];
+        snprintf(info_buf, 64, "Zoom: %.2f | FOV: %.1f%s", r->scene->view.zoom, fov, "\u00B0"); // degree symbol
+        const char *lines[] = {info_buf};
+        draw_styled_text_box(r, cr, width - 10, height - 10 - 30, lines, 1, 1);
+    }
+}
+
+// Cursor and hover overlays, drawn over the cached layer on every frame
+static void draw_overlays(SkyRenderer *r, cairo_t *cr, int width, int height) {
+    double radius = (width < height ? width : height) / 2.0 - 10;
+    double cx = width / 2.0;
+    double cy = height / 2.0;
+
+    cairo_save(cr);
+    cairo_arc(cr, cx + r->scene->view.pan_x * radius, cy + r->scene->view.pan_y * radius, radius * r->scene->view.zoom, 0, 2 * M_PI);
+    cairo_clip(cr);
+
+    // Hover Elevation Circle
+    if (r->scene->hover_active) {
+        cairo_set_source_rgba(cr, 1.0, 1.0, 0.0, 0.5); // Yellow transparent
+        cairo_set_line_width(cr, 2.0);
+
+        // Draw altitude circle at hover_elev
+        int first = 1;
+        cairo_new_path(cr);
+        for (int az = 0; az <= 360; az += 5) {
+            double u, v, tx, ty;
+            if (project(r, r->scene->hover_elev, az, &u, &v)) {
+                transform_point(r, u, v, &tx, &ty);
+                if (first) {
+                    cairo_move_to(cr, cx + tx * radius, cy + ty * radius);
+                    first = 0;
+                } else {
+                    cairo_line_to(cr, cx + tx * radius, cy + ty * radius);
+                }
+            } else first = 1;
+        }
+        cairo_stroke(cr);
+    }
+
+    // Hover Time Marker
+    if (r->scene->hover_active && r->scene->highlighted) {
+        double jd_hover = get_julian_day(r->scene->hover_time);
+        ObserverFrame hover_frame = r->layer_frame;
+        observer_frame_advance_jd(&hover_frame, r->scene->loc, jd_hover);
+
+        double alt, az;
+        observer_frame_get_horizontal(&hover_frame, r->scene->highlighted->ra, r->scene->highlighted->dec, &alt, &az);
+
+        double u, v, tx, ty;
+        if (project(r, alt, az, &u, &v)) {
+            transform_point(r, u, v, &tx, &ty);
+            cairo_set_source_rgb(cr, 1.0, 1.0, 0.0);
+            cairo_arc(cr, cx + tx * radius, cy + ty * radius, 6, 0, 2*M_PI);
+            cairo_fill(cr);
+        }
+    }
+
+    cairo_restore(cr);
+
+    if (r->scene->cursor_alt >= 0) {
+        struct ln_equ_posn equ; observer_frame_get_equatorial(&r->layer_frame, r->scene->cursor_alt, r->scene->cursor_az, &equ.ra, &equ.dec);
+        double dist_sun = ln_get_angular_separation(&equ, &r->layer_sun_equ);
+        double dist_moon = ln_get_angular_separation(&equ, &r->layer_moon_equ);
+
+        char buf_alt[64], buf_az[64], buf_sun[64], buf_moon[64], buf_coords[64];
+        snprintf(buf_alt, 64, "Alt: %.1f", r->scene->cursor_alt);
+        snprintf(buf_az, 64, "Az: %.1f", r->scene->cursor_az);
+        snprintf(buf_sun, 64, "Sun Dist: %.1f", dist_sun);
+        snprintf(buf_moon, 64, "Moon Dist: %.1f", dist_moon);
+        snprintf(buf_coords, 64, "RA:%.2f Dec:%.2f", equ.ra, equ.dec);
+
+        const char *lines[] = {buf_alt, buf_az, buf_sun, buf_moon, buf_coords};
+        draw_styled_text_box(r, cr, width - 10, 10, lines, 5, 1); // Right aligned
+    }
+}
+
+static void make_layer_key(const SkyRenderer *r, SkyLayerKey *key, int width, int height, int scale) {
+    const SkyScene *scene = r->scene;
+    memset(key, 0, sizeof(*key));
+    key->width = width;
+    key->height = height;
+    key->scale = scale;
+    key->view.zoom = scene->view.zoom;
+    key->view.pan_x = scene->view.pan_x;
+    key->view.pan_y = scene->view.pan_y;
+    key->view.rotation = scene->view.rotation;
+    key->view.horizon_projection = scene->view.horizon_projection;
+    key->view.horizon_center_az = scene->view.horizon_center_az;
+    key->loc = scene->loc;
+    key->dt = scene->dt;
+    key->options = scene->options;
+    key->highlighted = scene->highlighted;
+}
+
+// The sky layer, then the Sun/Moon positions the cursor box measures from
+static void draw_layer(SkyRenderer *r, cairo_t *cr, int width, int height) {
+    cairo_save(cr);
+    draw_sky_layer(r, cr, width, height);
+    cairo_restore(cr);
+
+    ephemeris_get_equ(EPHEMERIS_SUN, r->layer_frame.jd, &r->layer_sun_equ.ra, &r->layer_sun_equ.dec);
+    ephemeris_get_equ(EPHEMERIS_MOON, r->layer_frame.jd, &r->layer_moon_equ.ra, &r->layer_moon_equ.dec);
+}
+
+void sky_renderer_draw(SkyRenderer *r, cairo_t *cr, int width, int height, int scale, const SkyScene *scene) {
+    if (scale < 1) scale = 1;
+    r->scene = scene;
+
+    SkyLayerKey key;
+    make_layer_key(r, &key, width, height, scale);
+
+    if (!r->sky_layer || r->sky_layer_dirty || memcmp(&key, &r->sky_layer_key, sizeof(key)) != 0) {
+        if (!r->sky_layer || key.width != r->sky_layer_key.width || key.height != r->sky_layer_key.height || key.scale != r->sky_layer_key.scale) {
+            if (r->sky_layer) cairo_surface_destroy(r->sky_layer);
+            r->sky_layer = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width * scale, height * scale);
+            cairo_surface_set_device_scale(r->sky_layer, scale, scale);
+        }
+
+        cairo_t *layer_cr = cairo_create(r->sky_layer);
+        draw_layer(r, layer_cr, width, height);
+        cairo_destroy(layer_cr);
+
+        r->sky_layer_key = key;
+        r->sky_layer_dirty = 0;
+    }
+
+    cairo_set_source_surface(cr, r->sky_layer, 0, 0);
+    cairo_paint(cr);
+
+    draw_overlays(r, cr, width, height);
+    r->scene = NULL;
+}
+
+void sky_renderer_draw_direct(SkyRenderer *r, cairo_t *cr, int width, int height, const SkyScene *scene) {
+    r->scene = scene;
+    draw_layer(r, cr, width, height);
+    draw_overlays(r, cr, width, height);
+    r->scene = NULL;
+
+    // The layer frame and Sun/Moon positions now belong to this scene
+    r->sky_layer_dirty = 1;
+}
+
+void sky_renderer_invalidate(SkyRenderer *r) {
+    r->sky_layer_dirty = 1;
+}
+
+SkyRenderer *sky_renderer_new() {
+    SkyRenderer *r = calloc(1, sizeof(SkyRenderer));
+    if (!r) {
+        fprintf(stderr, "Out of memory for the sky renderer.\n");
+        return NULL;
+    }
+    r->sky_layer_dirty = 1;
+    return r;
+}
+
+static void polyline_free(SkyPolyline *pl) {
+    free(pl->alt);
+    free(pl->az);
+    free(pl->u);
+    free(pl->v);
+    free(pl->move);
+    memset(pl, 0, sizeof(*pl));
+}
+
+void sky_renderer_free(SkyRenderer *r) {
+    if (!r) return;
+    free(r->star_batch_idx); free(r->star_batch_alt); free(r->star_batch_az); free(r->star_sprites); free(r->star_bucket_next);
+    free(r->star_stale_idx); free(r->star_u); free(r->star_v); free(r->star_uv_visible); free(r->star_uv_gen);
+    if (r->sky_layer) cairo_surface_destroy(r->sky_layer);
+    polyline_free(&r->altaz_grid_curves);
+    polyline_free(&r->radec_grid_curves);
+    polyline_free(&r->ecliptic_curve);
+    polyline_free(&r->constellation_curves);
+    free(r->constellation_geometry);
+    free(r->constellation_alt);
+    free(r->constellation_az);
+    free(r);
+}
+
+void sky_view_state_init(SkyViewState *view, int horizon_projection) {
+    view->zoom = 1.0;
+    view->pan_x = 0.0;
+    view->pan_y = horizon_projection ? 0.8 : 0.0; // Horizon at 10% from the bottom
+    view->rotation = 0.0;
+    view->horizon_projection = horizon_projection;
+    view->horizon_center_az = 180.0;
+}
+
+void sky_scene_init(SkyScene *scene, Location loc, DateTime dt, const SkyViewOptions *options) {
+    memset(scene, 0, sizeof(*scene));
+    scene->loc = loc;
+    scene->dt = dt;
+    scene->options = *options;
+    sky_view_state_init(&scene->view, 0);
+    scene->highlighted = NULL;
+    scene->cursor_alt = -1;
+    scene->cursor_az = -1;
+    scene->hover_active = 0;
+}
+
+int sky_chart_format_parse(const char *text, SkyChartFormat *format) {
+    const char *ext = strrchr(text, '.');
+    ext = ext ? ext + 1 : text;
+    if (strcasecmp(ext, "png") == 0) *format = SKY_CHART_PNG;
+    else if (strcasecmp(ext, "svg") == 0) *format = SKY_CHART_SVG;
+    else if (strcasecmp(ext, "pdf") == 0) *format = SKY_CHART_PDF;
+    else return -1;
+    return 0;
+}
+
+int sky_renderer_write_chart(SkyRenderer *r, const char *filename, SkyChartFormat format, int width, int height, const SkyScene *scene) {
+    cairo_surface_t *surface;
+    switch (format) {
+        case SKY_CHART_SVG: surface = cairo_svg_surface_create(filename, width, height); break;
+        case SKY_CHART_PDF: surface = cairo_pdf_surface_create(filename, width, height); break;
+        default: surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height); break;
+    }
+    cairo_status_t status = cairo_surface_status(surface);
+    if (status != CAIRO_STATUS_SUCCESS) {
+        fprintf(stderr, "Cannot create %s: %s\n", filename, cairo_status_to_string(status));
+        cairo_surface_destroy(surface);
+        return -1;
+    }
+
+    // Straight onto the target so that SVG and PDF charts stay vector
+    cairo_t *cr = cairo_create(surface);
+    sky_renderer_draw_direct(r, cr, width, height, scene);
+    cairo_destroy(cr);
+
+    if (format == SKY_CHART_PNG) {
+        status = cairo_surface_write_to_png(surface, filename);
+    } else {
+        cairo_surface_finish(surface);
+        status = cairo_surface_status(surface);
+    }
+    cairo_surface_destroy(surface);
+
+    if (status != CAIRO_STATUS_SUCCESS) {
+        fprintf(stderr, "Failed to write %s: %s\n", filename, cairo_status_to_string(status));
+        return -1;
+    }
+    return 0;
+}
+
+// Frames of a time-lapse, split over the worker pool
+typedef struct {
+    const SkyScene *scene;
+    JulianDay start;
+    double step;
+    int width, height;
+    const char *pattern;
+    int *failed; // Per frame
+} TimelapseJob;
+
+// Each chunk draws with its own renderer and surface; consecutive frames of a
+// chunk reuse the renderer's star and curve caches
+static void render_timelapse_chunk(int begin, int end, void *ctx) {
+    const TimelapseJob *job = ctx;
+    SkyRenderer *r = sky_renderer_new();
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, job->width, job->height);
+    cairo_status_t status = cairo_surface_status(surface);
+    if (!r || status != CAIRO_STATUS_SUCCESS) {
+        fprintf(stderr, "Cannot create a %d x %d frame: %s\n", job->width, job->height,
+                r ? cairo_status_to_string(status) : "out of memory");
+        for (int i = begin; i < end; i++) job->failed[i] = 1;
+        cairo_surface_destroy(surface);
+        if (r) sky_renderer_free(r);
+        return;
+    }
+
+    for (int i = begin; i < end; i++) {
+        SkyScene scene = *job->scene;
+        scene.dt = datetime_from_julian_day(job->start + i * job->step, job->scene->dt.timezone_offset);
+
+        cairo_t *cr = cairo_create(surface);
+        sky_renderer_draw_direct(r, cr, job->width, job->height, &scene);
+        cairo_destroy(cr);
+
+        char filename[1024];
+        snprintf(filename, sizeof(filename), job->pattern, i);
+        status = cairo_surface_write_to_png(surface, filename);
+        if (status != CAIRO_STATUS_SUCCESS) {
+            fprintf(stderr, "Failed to write %s: %s\n", filename, cairo_status_to_string(status));
+            job->failed[i] = 1;
+        }
+    }
+
+    cairo_surface_destroy(surface);
+    sky_renderer_free(r);
+}
+
+int sky_render_timelapse(const SkyScene *scene, JulianDay start, double step, int count, int width, int height, const char *pattern) {
+    if (count <= 0) return 0;
+    int *failed = calloc(count, sizeof(int));
+    if (!failed) {
+        fprintf(stderr, "Out of memory for %d frames\n", count);
+        return count;
+    }
+
+    // One chunk per thread, so that each worker keeps a single renderer
+    // and surface across its frames
+    int threads = parallel_get_threads();
+    int per_thread = (count + threads - 1) / threads;
+    TimelapseJob job = {scene, start, step, width, height, pattern, failed};
+    parallel_for(count, per_thread, render_timelapse_chunk, &job);
+
+    int num_failed = 0;
+    for (int i = 0; i < count; i++) num_failed += failed[i];
+    free(failed);
+    return num_failed;
+}
@@ -0,0 +1,114 @@
+#ifndef SKY_RENDER_H
+#define SKY_RENDER_H
+
+#include <cairo.h>
+#include "sky_model.h"
+#include "target_list.h"
+
+typedef struct {
+    int show_constellation_lines;
+    int show_constellation_names;
+    int show_alt_az_grid;
+    int show_ra_dec_grid;
+    int show_planets;
+    int show_moon_circles;
+    int show_ecliptic;
+    double star_mag_limit;
+    double star_size_m0;
+    double star_size_ma;
+    int show_star_colors;
+    double star_saturation;
+    int auto_star_settings;
+    double font_scale;
+    int ephemeris_use_ut;
+} SkyViewOptions;
+
+// Where the sky sits in the chart. The projection maps alt/az to u/v (the
+// horizon circle has radius 1); rotation, zoom and pan then place u/v in the
+// chart, in units of the chart radius.
+typedef struct {
+    double zoom;
+    double pan_x; // Normalized units
+    double pan_y; // Normalized units
+    double rotation; // Radians
+    int horizon_projection; // Stereographic towards horizon_center_az instead of the zenith view
+    double horizon_center_az; // Az 0=South, 180=North
+} SkyViewState;
+
+// Everything one frame shows
+typedef struct {
+    Location loc;
+    DateTime dt;
+    SkyViewOptions options;
+    SkyViewState view;
+    const Target *highlighted; // Its trajectory over the night is drawn; NULL for none
+
+    // Overlays, drawn over the cached layer
+    double cursor_alt, cursor_az; // Cursor info box; cursor_alt < 0 for none
+    int hover_active; // Elevation graph hover: altitude circle and time marker
+    DateTime hover_time;
+    double hover_elev;
+} SkyScene;
+
+// Draws sky charts into cairo contexts. A renderer keeps the caches that make
+// consecutive frames cheap (projected stars, grid and constellation curves,
+// the retained layer), so it is meant to be reused across frames. It shares
+// the catalog read-only: separate renderers may draw on separate threads.
+typedef struct SkyRenderer SkyRenderer;
+
+typedef enum {
+    SKY_CHART_PNG,
+    SKY_CHART_SVG,
+    SKY_CHART_PDF
+} SkyChartFormat;
+
+SkyRenderer *sky_renderer_new();
+void sky_renderer_free(SkyRenderer *r);
+
+// Default view: whole sky, upright, facing north in the horizon projection
+void sky_view_state_init(SkyViewState *view, int horizon_projection);
+
+// Scene for a site and time with the default view, no highlighted target and
+// no overlays
+void sky_scene_init(SkyScene *scene, Location loc, DateTime dt, const SkyViewOptions *options);
+
+// One frame of width x height units. Everything but the overlays goes through
+// a retained image layer with `scale` pixels per unit, redrawn only when the
+// scene changes: the widget's path.
+void sky_renderer_draw(SkyRenderer *r, cairo_t *cr, int width, int height, int scale, const SkyScene *scene);
+
+// One frame drawn straight into cr, without the retained layer: for vector
+// surfaces and for frames that never repeat
+void sky_renderer_draw_direct(SkyRenderer *r, cairo_t *cr, int width, int height, const SkyScene *scene);
+
+// Marks the retained layer stale for changes the scene cannot see (target lists)
+void sky_renderer_invalidate(SkyRenderer *r);
+
+// Writes a chart file. Returns 0 on success, -1 (with a message on stderr) on error.
+int sky_renderer_write_chart(SkyRenderer *r, const char *filename, SkyChartFormat format, int width, int height, const SkyScene *scene);
+
+// Writes count PNG frames, the scene at start, start + step, ... (Julian
+// days), named by pattern, a printf format taking the frame index ("%04d").
+// Frames are drawn on the worker pool, each worker with its own renderer and
+// image surface. Returns the number of frames that could not be written.
+int sky_render_timelapse(const SkyScene *scene, JulianDay start, double step, int count, int width, int height, const char *pattern);
+
+// Format from a name ("png", "svg", "pdf") or a file name's extension.
+// Returns -1 if there is none.
+int sky_chart_format_parse(const char *text, SkyChartFormat *format);
+
+// Chart geometry shared with the widget's pointer handling: the horizon
+// circle's centre and radius in chart units
+void sky_chart_geometry(int width, int height, double *cx, double *cy, double *radius);
+
+// Alt/az (degrees) to u/v; returns 0 for points that cannot be shown
+int sky_project(const SkyViewState *view, double alt, double az, double *u, double *v);
+
+// u/v back to alt/az; alt is -1 outside the zenith projection's horizon
+void sky_unproject(const SkyViewState *view, double u, double v, double *alt, double *az);
+
+// u/v to normalized chart coordinates (rotation, zoom, pan) and back
+void sky_view_transform(const SkyViewState *view, double u, double v, double *tx, double *ty);
+void sky_view_untransform(const SkyViewState *view, double tx, double ty, double *u, double *v);
+
+#endif
@@ -2,26 +2,7 @@
 #define SKY_VIEW_H
 
 #include <gtk/gtk.h>
-#include "sky_model.h"
-#include "target_list.h"
-
-typedef struct {
-    gboolean show_constellation_lines;
-    gboolean show_constellation_names;
-    gboolean show_alt_az_grid;
-    gboolean show_ra_dec_grid;
-    gboolean show_planets;
-    gboolean show_moon_circles;
-    gboolean show_ecliptic;
-    double star_mag_limit;
-    double star_size_m0;
-    double star_size_ma;
-    gboolean show_star_colors;
-    double star_saturation;
-    gboolean auto_star_settings;
-    double font_scale;
-    gboolean ephemeris_use_ut;
-} SkyViewOptions;
+#include "sky_render.h"
 
 GtkWidget *create_sky_view(Location *loc, DateTime *dt, SkyViewOptions *options, void (*on_sky_click)(double alt, double az));
 void sky_view_redraw();
@@ -1,8 +1,11 @@
 #include "source_selection.h"
 #include "catalog.h"
+#include "star_index.h"
+#include "star_color.h"
 #include "target_list.h"
 #include "sky_view.h"
 #include "elevation_view.h"
+#include "ephemeris.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -66,16 +69,8 @@ static double get_planet_mag(PlanetID p, double jd) {
     }
 }
 
-static void get_planet_equ(PlanetID p, double jd, struct ln_equ_posn *pos) {
-    switch(p) {
-        case PLANET_MERCURY: ln_get_mercury_equ_coords(jd, pos); break;
-        case PLANET_VENUS:   ln_get_venus_equ_coords(jd, pos); break;
-        case PLANET_MARS:    ln_get_mars_equ_coords(jd, pos); break;
-        case PLANET_JUPITER: ln_get_jupiter_equ_coords(jd, pos); break;
-        case PLANET_SATURN:  ln_get_saturn_equ_coords(jd, pos); break;
-        case PLANET_URANUS:  ln_get_uranus_equ_coords(jd, pos); break;
-        case PLANET_NEPTUNE: ln_get_neptune_equ_coords(jd, pos); break;
-    }
+static void get_body_equ(EphemerisBody body, double jd, struct ln_equ_posn *pos) {
+    ephemeris_get_equ(body, jd, &pos->ra, &pos->dec);
 }
 
 static void update_candidate_list() {
@@ -83,30 +78,35 @@ static void update_candidate_list() {
     candidates = NULL;
     candidate_count = 0;
 
-    double jd = get_julian_day(*dlg_dt);
+    ObserverFrame frame;
+    observer_frame_init(&frame, *dlg_loc, *dlg_dt);
+    double jd = frame.jd;
     struct ln_equ_posn center_equ = {center_ra, center_dec};
 
-    int max_cand = num_stars + 20;
+    // Stars: only the index cells overlapping the search cone are visited
+    int num_found = 0;
+    int *found = catalog_cone_search(center_ra, center_dec, search_fov, HUGE_VAL, &num_found);
+
+    int max_cand = num_found + 20;
     candidates = malloc(sizeof(Candidate) * max_cand);
 
-    // Stars
-    for (int i=0; i<num_stars; i++) {
-        struct ln_equ_posn star_equ = {stars[i].ra, stars[i].dec};
+    for (int k=0; k<num_found; k++) {
+        Star star = catalog_get_star(found[k]);
+        struct ln_equ_posn star_equ = {star.ra, star.dec};
         double dist = ln_get_angular_separation(&center_equ, &star_equ);
-        if (dist <= search_fov) {
-            candidates[candidate_count].ra = stars[i].ra;
-            candidates[candidate_count].dec = stars[i].dec;
-            candidates[candidate_count].mag = stars[i].mag;
-            candidates[candidate_count].dist = dist;
-            candidates[candidate_count].bv = stars[i].bv;
-            if (stars[i].id) {
-                snprintf(candidates[candidate_count].name, 64, "%s (Mag %.1f)", stars[i].id, stars[i].mag);
-            } else {
-                snprintf(candidates[candidate_count].name, 64, "Star (Mag %.1f)", stars[i].mag);
-            }
-            candidate_count++;
+        candidates[candidate_count].ra = star.ra;
+        candidates[candidate_count].dec = star.dec;
+        candidates[candidate_count].mag = star.mag;
+        candidates[candidate_count].dist = dist;
+        candidates[candidate_count].bv = star.bv;
+        if (star.id) {
+            snprintf(candidates[candidate_count].name, 64, "%s (Mag %.1f)", star.id, star.mag);
+        } else {
+            snprintf(candidates[candidate_count].name, 64, "Star (Mag %.1f)", star.mag);
         }
+        candidate_count++;
     }
+    free(found);
 
     // Planets
     PlanetID p_ids[] = {PLANET_MERCURY, PLANET_VENUS, PLANET_MARS, PLANET_JUPITER, PLANET_SATURN, PLANET_URANUS, PLANET_NEPTUNE};
@@ -114,7 +114,7 @@ static void update_candidate_list() {
 
     for (int p=0; p<7; p++) {
          struct ln_equ_posn p_equ;
-         get_planet_equ(p_ids[p], jd, &p_equ);
+         get_body_equ(EPHEMERIS_PLANET(p_ids[p]), jd, &p_equ);
          double dist = ln_get_angular_separation(&center_equ, &p_equ);
          if (dist <= search_fov) {
             candidates[candidate_count].ra = p_equ.ra;
@@ -129,7 +129,7 @@ static void update_candidate_list() {
 
     // Sun
     struct ln_equ_posn sun_equ;
-    ln_get_solar_equ_coords(jd, &sun_equ);
+    get_body_equ(EPHEMERIS_SUN, jd, &sun_equ);
     double sun_dist = ln_get_angular_separation(&center_equ, &sun_equ);
     if (sun_dist <= search_fov) {
         candidates[candidate_count].ra = sun_equ.ra;
@@ -143,7 +143,7 @@ static void update_candidate_list() {
 
     // Moon
     struct ln_equ_posn moon_equ;
-    ln_get_lunar_equ_coords(jd, &moon_equ);
+    get_body_equ(EPHEMERIS_MOON, jd, &moon_equ);
     double moon_dist = ln_get_angular_separation(&center_equ, &moon_equ);
     if (moon_dist <= search_fov) {
         candidates[candidate_count].ra = moon_equ.ra;
@@ -215,23 +215,6 @@ static int is_in_roi(double val_x, double mag) {
     return (val_x >= roi.min_x && val_x <= roi.max_x && mag >= roi.min_y && mag <= roi.max_y);
 }
 
-// B-V to RGB (Replicated from sky_view.c)
-static void plot_bv_to_rgb(double bv, double *r, double *g, double *b) {
-    if (bv < 0.0) { *r = 0.6; *g = 0.6; *b = 1.0; } // Blue
-    else if (bv < 0.5) {
-        double t = bv / 0.5;
-        *r = 0.6 + 0.4*t; *g = 0.6 + 0.4*t; *b = 1.0;
-    } else if (bv < 1.0) {
-        double t = (bv - 0.5) / 0.5;
-        *r = 1.0; *g = 1.0; *b = 1.0 - 0.5*t;
-    } else if (bv < 1.5) {
-        double t = (bv - 1.0) / 0.5;
-        *r = 1.0; *g = 1.0 - 0.4*t; *b = 0.5 - 0.5*t;
-    } else {
-        *r = 1.0; *g = 0.6; *b = 0.0; // Red
-    }
-}
-
 // Forward decl
 static void populate_list();
 
@@ -301,7 +284,7 @@ static void on_plot_draw(GtkDrawingArea *area, cairo_t *cr, int width, int heigh
         map_point(val_x, candidates[i].mag, &x, &y);
 
         double r, g, b;
-        plot_bv_to_rgb(candidates[i].bv, &r, &g, &b);
+        star_color_bv_to_rgb(candidates[i].bv, &r, &g, &b);
 
         if (roi.active && !in_r) {
             cairo_set_source_rgba(cr, r, g, b, 0.2); // Greyed/Dimmed color
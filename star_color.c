@@ -0,0 +1,70 @@
+#include "star_color.h"
+
+void star_color_bv_to_rgb(double bv, double *r, double *g, double *b) {
+    if (bv < 0.0) { *r = 0.6; *g = 0.6; *b = 1.0; } // Blue
+    else if (bv < 0.5) {
+        double t = bv / 0.5;
+        *r = 0.6 + 0.4*t; *g = 0.6 + 0.4*t; *b = 1.0;
+    } else if (bv < 1.0) {
+        double t = (bv - 0.5) / 0.5;
+        *r = 1.0; *g = 1.0; *b = 1.0 - 0.5*t;
+    } else if (bv < 1.5) {
+        double t = (bv - 1.0) / 0.5;
+        *r = 1.0; *g = 1.0 - 0.4*t; *b = 0.5 - 0.5*t;
+    } else {
+        *r = 1.0; *g = 0.6; *b = 0.0; // Red
+    }
+}
+
+unsigned char star_color_index(double bv) {
+    if (bv < 0.0) return 0;
+    if (bv >= STAR_COLOR_BV_MAX) return STAR_COLOR_INDEX_COUNT - 1;
+    int k = 1 + (int)(bv / STAR_COLOR_BV_MAX * (STAR_COLOR_INDEX_COUNT - 2));
+    if (k > STAR_COLOR_INDEX_COUNT - 2) k = STAR_COLOR_INDEX_COUNT - 2;
+    return (unsigned char)k;
+}
+
+// Representative B-V of an index (centre of its bin)
+static double star_color_index_bv(int k) {
+    if (k == 0) return -0.1;
+    if (k == STAR_COLOR_INDEX_COUNT - 1) return STAR_COLOR_BV_MAX;
+    return (k - 1 + 0.5) * STAR_COLOR_BV_MAX / (STAR_COLOR_INDEX_COUNT - 2);
+}
+
+static double clamp01(double x) {
+    if (x < 0) return 0;
+    if (x > 1) return 1;
+    return x;
+}
+
+void star_color_table_update(StarColorTable *table, double m0, double ma, double saturation) {
+    if (table->valid && table->m0 == m0 && table->ma == ma && table->saturation == saturation) {
+        return;
+    }
+
+    for (int k = 0; k < STAR_COLOR_INDEX_COUNT; k++) {
+        double r, g, b;
+        star_color_bv_to_rgb(star_color_index_bv(k), &r, &g, &b);
+        table->rgb[k][0] = clamp01(1.0 + (r - 1.0) * saturation);
+        table->rgb[k][1] = clamp01(1.0 + (g - 1.0) * saturation);
+        table->rgb[k][2] = clamp01(1.0 + (b - 1.0) * saturation);
+    }
+
+    for (int k = 0; k < STAR_MAG_LUT_SIZE; k++) {
+        double mag = STAR_MAG_LUT_MIN + k * STAR_MAG_LUT_STEP;
+        double size = (m0 - mag) * ma;
+        double brightness = 1.0;
+        if (size < 1.0) {
+            brightness = size;
+            if (brightness < 0.1) brightness = 0.1;
+            size = 1.0;
+        }
+        table->size[k] = size;
+        table->brightness[k] = brightness;
+    }
+
+    table->m0 = m0;
+    table->ma = ma;
+    table->saturation = saturation;
+    table->valid = 1;
+}
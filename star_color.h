@@ -0,0 +1,41 @@
+#ifndef STAR_COLOR_H
+#define STAR_COLOR_H
+
+// B-V colour index quantization: index 0 is everything bluer than B-V 0,
+// the last index everything redder than 1.5, and the indices between cover
+// [0, 1.5) linearly (the range where the colour ramp changes).
+#define STAR_COLOR_INDEX_COUNT 256
+#define STAR_COLOR_BV_MAX 1.5
+
+// Magnitude quantization for the size/brightness table: 0.01 mag steps
+#define STAR_MAG_LUT_MIN -2.0
+#define STAR_MAG_LUT_MAX 16.0
+#define STAR_MAG_LUT_STEP 0.01
+#define STAR_MAG_LUT_SIZE 1801
+
+// Colour and size tables for one set of star display options
+typedef struct {
+    int valid;
+    double m0, ma, saturation; // Options the tables were built for
+    double rgb[STAR_COLOR_INDEX_COUNT][3]; // Saturation applied and clamped to 0..1
+    double size[STAR_MAG_LUT_SIZE]; // Disc radius in pixels (at least 1)
+    double brightness[STAR_MAG_LUT_SIZE]; // 0.1..1, dims stars drawn at the minimum size
+} StarColorTable;
+
+// Piecewise B-V to RGB ramp (blue-white-yellow-red)
+void star_color_bv_to_rgb(double bv, double *r, double *g, double *b);
+
+// Quantized colour index of a B-V value
+unsigned char star_color_index(double bv);
+
+// Rebuilds the tables if the options differ from the ones they were built for
+void star_color_table_update(StarColorTable *table, double m0, double ma, double saturation);
+
+static inline int star_mag_lut_index(double mag) {
+    int k = (int)((mag - STAR_MAG_LUT_MIN) / STAR_MAG_LUT_STEP + 0.5);
+    if (k < 0) k = 0;
+    if (k >= STAR_MAG_LUT_SIZE) k = STAR_MAG_LUT_SIZE - 1;
+    return k;
+}
+
+#endif
@@ -0,0 +1,269 @@
+#include "star_index.h"
+#include "catalog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define NSIDE STAR_INDEX_NSIDE
+#define NPIX STAR_INDEX_NPIX
+#define NCAP (2 * NSIDE * (NSIDE - 1)) // Pixels in the north polar cap
+#define NRINGS (4 * NSIDE - 1)
+
+// Counting-sorted cell lists: stars of cell c are cell_stars[cell_start[c] .. cell_start[c+1]-1]
+static int *cell_start = NULL;
+static int *cell_stars = NULL;
+
+// Largest angle between a star and the centre of its cell (radians). Queries
+// widen their radius by this so a cell is kept whenever any of its stars could match.
+static double cell_margin = 0.0;
+
+// Ring geometry: pixel j of ring i (1..4N-1) sits at phi = (j + phi_offset) * 2pi / n
+static void ring_geometry(int ring, int *start, int *n, double *z, double *phi_offset) {
+    if (ring < NSIDE) {
+        *n = 4 * ring;
+        *start = 2 * ring * (ring - 1);
+        *z = 1.0 - (double)ring * ring / (3.0 * NSIDE * NSIDE);
+        *phi_offset = 0.5;
+    } else if (ring <= 3 * NSIDE) {
+        *n = 4 * NSIDE;
+        *start = NCAP + (ring - NSIDE) * 4 * NSIDE;
+        *z = 4.0 / 3.0 - 2.0 * ring / (3.0 * NSIDE);
+        *phi_offset = ((ring + NSIDE) & 1) ? 0.0 : 0.5;
+    } else {
+        int k = 4 * NSIDE - ring;
+        *n = 4 * k;
+        *start = NPIX - 2 * k * (k + 1);
+        *z = -(1.0 - (double)k * k / (3.0 * NSIDE * NSIDE));
+        *phi_offset = 0.5;
+    }
+}
+
+static void cell_center(int pix, double v[3]) {
+    int ring, j;
+    if (pix < NCAP) {
+        ring = (1 + (int)sqrt(1.0 + 2.0 * pix + 0.5)) / 2;
+        j = pix - 2 * ring * (ring - 1);
+    } else if (pix < NPIX - NCAP) {
+        int ip = pix - NCAP;
+        ring = ip / (4 * NSIDE) + NSIDE;
+        j = ip % (4 * NSIDE);
+    } else {
+        int ip = NPIX - pix;
+        int k = (1 + (int)sqrt(2.0 * ip - 1.0 + 0.5)) / 2;
+        ring = 4 * NSIDE - k;
+        j = pix - (NPIX - 2 * k * (k + 1));
+    }
+
+    int start, n;
+    double z, offset;
+    ring_geometry(ring, &start, &n, &z, &offset);
+    double phi = (j + offset) * 2.0 * M_PI / n;
+    double s = sqrt(1.0 - z * z);
+    v[0] = s * cos(phi);
+    v[1] = s * sin(phi);
+    v[2] = z;
+}
+
+int star_index_cell_of(double x, double y, double z) {
+    double za = fabs(z);
+    double phi = atan2(y, x);
+    if (phi < 0) phi += 2.0 * M_PI;
+    double tt = phi / (0.5 * M_PI); // in [0,4)
+    if (tt >= 4.0) tt = 0.0;
+
+    if (za <= 2.0 / 3.0) {
+        // Equatorial region
+        double t1 = NSIDE * (0.5 + tt);
+        double t2 = NSIDE * z * 0.75;
+        int jp = (int)(t1 - t2); // index of ascending edge line
+        int jm = (int)(t1 + t2); // index of descending edge line
+        int ir = NSIDE + 1 + jp - jm; // ring number counted from z = 2/3, in 1..2N+1
+        int kshift = 1 - (ir & 1);
+        int ip = (jp + jm - NSIDE + kshift + 1) / 2;
+        ip = ((ip % (4 * NSIDE)) + 4 * NSIDE) % (4 * NSIDE);
+        return NCAP + (ir - 1) * 4 * NSIDE + ip;
+    }
+
+    // Polar caps
+    double tp = tt - (int)tt;
+    double tmp = NSIDE * sqrt(3.0 * (1.0 - za));
+    int jp = (int)(tp * tmp);
+    int jm = (int)((1.0 - tp) * tmp);
+    int ir = jp + jm + 1; // ring number counted from the closest pole
+    int ip = (int)(tt * ir);
+    if (ip >= 4 * ir) ip -= 4 * ir;
+    return (z > 0) ? 2 * ir * (ir - 1) + ip : NPIX - 2 * ir * (ir + 1) + ip;
+}
+
+void star_index_free() {
+    free(cell_start);
+    free(cell_stars);
+    cell_start = NULL;
+    cell_stars = NULL;
+    cell_margin = 0.0;
+}
+
+int star_index_build() {
+    star_index_free();
+
+    cell_start = calloc(NPIX + 1, sizeof(int));
+    cell_stars = malloc(sizeof(int) * (num_stars > 0 ? num_stars : 1));
+    int *star_cell = malloc(sizeof(int) * (num_stars > 0 ? num_stars : 1));
+    if (!cell_start || !cell_stars || !star_cell) {
+        fprintf(stderr, "Error: could not allocate star index.\n");
+        free(star_cell);
+        star_index_free();
+        return -1;
+    }
+
+    // Counting sort by cell. Walking the catalog in order keeps each cell's
+    // list sorted by magnitude.
+    double min_dot = 1.0;
+    for (int i = 0; i < num_stars; i++) {
+        int c = star_index_cell_of(star_catalog.x[i], star_catalog.y[i], star_catalog.z[i]);
+        star_cell[i] = c;
+        cell_start[c + 1]++;
+
+        double v[3];
+        cell_center(c, v);
+        double dot = v[0] * star_catalog.x[i] + v[1] * star_catalog.y[i] + v[2] * star_catalog.z[i];
+        if (dot < min_dot) min_dot = dot;
+    }
+    for (int c = 0; c < NPIX; c++) {
+        cell_start[c + 1] += cell_start[c];
+    }
+
+    int *fill = malloc(sizeof(int) * NPIX);
+    if (!fill) {
+        free(star_cell);
+        star_index_free();
+        return -1;
+    }
+    for (int c = 0; c < NPIX; c++) fill[c] = cell_start[c];
+    for (int i = 0; i < num_stars; i++) {
+        cell_stars[fill[star_cell[i]]++] = i;
+    }
+    free(fill);
+    free(star_cell);
+
+    if (min_dot > 1.0) min_dot = 1.0;
+    cell_margin = acos(min_dot) + 1e-9;
+    return 0;
+}
+
+int star_index_query_cells(double ra, double dec, double radius, int *cells, int max_cells) {
+    double ra_rad = ra * M_PI / 180.0;
+    double dec_rad = dec * M_PI / 180.0;
+    double theta_c = M_PI / 2.0 - dec_rad; // colatitude
+    double reach = radius * M_PI / 180.0 + cell_margin;
+    if (reach >= M_PI) reach = M_PI;
+    double cos_reach = cos(reach);
+    double sin_tc = sin(theta_c);
+    double cos_tc = cos(theta_c);
+
+    int found = 0;
+    for (int ring = 1; ring <= NRINGS; ring++) {
+        int start, n;
+        double z, offset;
+        ring_geometry(ring, &start, &n, &z, &offset);
+
+        double theta = acos(z);
+        if (fabs(theta - theta_c) > reach) continue;
+
+        // Half-width in phi of the part of this ring within reach of the centre
+        int full = 0;
+        double half = 0.0;
+        double sin_t = sqrt(1.0 - z * z);
+        double denom = sin_tc * sin_t;
+        if (denom < 1e-12) {
+            full = 1; // The centre is at a pole
+        } else {
+            double c = (cos_reach - cos_tc * z) / denom;
+            if (c <= -1.0) full = 1;
+            else if (c >= 1.0) half = 0.0;
+            else half = acos(c);
+        }
+
+        double dphi = 2.0 * M_PI / n;
+        int j_lo = 0, j_hi = n - 1;
+        if (!full) {
+            j_lo = (int)ceil((ra_rad - half) / dphi - offset);
+            j_hi = (int)floor((ra_rad + half) / dphi - offset);
+            if (j_hi - j_lo + 1 >= n) {
+                j_lo = 0;
+                j_hi = n - 1;
+            }
+        }
+
+        for (int j = j_lo; j <= j_hi; j++) {
+            if (found < max_cells) {
+                cells[found] = start + ((j % n) + n) % n;
+            }
+            found++;
+        }
+    }
+    return found;
+}
+
+const int *star_index_cell_stars(int cell, int *count) {
+    if (!cell_start || cell < 0 || cell >= NPIX) {
+        *count = 0;
+        return NULL;
+    }
+    *count = cell_start[cell + 1] - cell_start[cell];
+    return cell_stars + cell_start[cell];
+}
+
+int *catalog_cone_search(double ra, double dec, double radius, double mag_limit, int *count) {
+    *count = 0;
+    if (!cell_start) return NULL;
+
+    int cell_buf[1024];
+    int *cells = cell_buf;
+    int num_cells = star_index_query_cells(ra, dec, radius, cell_buf, 1024);
+    if (num_cells > 1024) {
+        cells = malloc(sizeof(int) * num_cells);
+        if (!cells) return NULL;
+        star_index_query_cells(ra, dec, radius, cells, num_cells);
+    }
+
+    double ra_rad = ra * M_PI / 180.0;
+    double dec_rad = dec * M_PI / 180.0;
+    double cx = cos(dec_rad) * cos(ra_rad);
+    double cy = cos(dec_rad) * sin(ra_rad);
+    double cz = sin(dec_rad);
+    double min_dot = cos(radius * M_PI / 180.0);
+
+    int *result = NULL;
+    int capacity = 0;
+    for (int k = 0; k < num_cells; k++) {
+        int n;
+        const int *list = star_index_cell_stars(cells[k], &n);
+        for (int m = 0; m < n; m++) {
+            int i = list[m];
+            if (star_catalog.mag[i] > mag_limit) break; // Cell lists are magnitude sorted
+            double dot = cx * star_catalog.x[i] + cy * star_catalog.y[i] + cz * star_catalog.z[i];
+            if (dot < min_dot) continue;
+
+            if (*count >= capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                int *grown = realloc(result, sizeof(int) * capacity);
+                if (!grown) {
+                    free(result);
+                    if (cells != cell_buf) free(cells);
+                    *count = 0;
+                    return NULL;
+                }
+                result = grown;
+            }
+            result[(*count)++] = i;
+        }
+    }
+
+    if (cells != cell_buf) free(cells);
+    return result;
+}
@@ -0,0 +1,29 @@
+#ifndef STAR_INDEX_H
+#define STAR_INDEX_H
+
+// HEALPix (ring scheme) cell index over the star catalog.
+// nside 32 gives 12288 cells of ~1.8 deg, about 10 Hipparcos stars per cell.
+#define STAR_INDEX_NSIDE 32
+#define STAR_INDEX_NPIX (12 * STAR_INDEX_NSIDE * STAR_INDEX_NSIDE)
+
+// Built by load_catalog() and released by free_catalog()
+int star_index_build();
+void star_index_free();
+
+// Cell containing an equatorial unit vector
+int star_index_cell_of(double x, double y, double z);
+
+// Cells that may hold stars within radius (degrees) of ra/dec (degrees).
+// Writes up to max_cells cell ids and returns the number of cells found,
+// which may exceed max_cells.
+int star_index_query_cells(double ra, double dec, double radius, int *cells, int max_cells);
+
+// Stars of one cell, as catalog indices in increasing magnitude order
+const int *star_index_cell_stars(int cell, int *count);
+
+// Catalog indices of stars within radius (degrees) of ra/dec with mag <= mag_limit
+// (pass a large limit for no bound). Returns a malloc'd array the caller frees,
+// or NULL if nothing matched; the number of entries is stored in *count.
+int *catalog_cone_search(double ra, double dec, double radius, double mag_limit, int *count);
+
+#endif
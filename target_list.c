@@ -16,8 +16,10 @@ static TargetList **lists = NULL;
 static int list_count = 0;
 static int list_capacity = 0;
 static void (*change_cb)(void) = NULL;
+static unsigned long revision = 0;
 
 static void notify_change() {
+    revision++;
     if (change_cb) change_cb();
 }
 
@@ -39,6 +41,7 @@ void target_list_cleanup() {
     lists = NULL;
     list_count = 0;
     list_capacity = 0;
+    revision++;
 }
 
 int target_list_get_list_count() {
@@ -275,3 +278,7 @@ bool target_list_is_visible(TargetList *list) {
 void target_list_set_change_callback(void (*cb)(void)) {
     change_cb = cb;
 }
+
+unsigned long target_list_get_revision() {
+    return revision;
+}
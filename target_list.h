@@ -46,4 +46,8 @@ void target_list_deserialize_and_add(TargetList *list, const char *data);
 // Callbacks
 void target_list_set_change_callback(void (*cb)(void));
 
+// Incremented on every change to any list (the same events as the change
+// callback), so caches of per-target data can tell when to refresh
+unsigned long target_list_get_revision();
+
 #endif